@@ -0,0 +1,41 @@
+#include "arguments.h"
+
+#include <stdlib.h>     // for strtoul()
+
+#include "kmer.h"
+
+unsigned* ThresholdOption(const std::string &option, Thresholds* thresholds) {
+  if (option == "--tail-len") return &thresholds->tail_len;
+  if (option == "--max-mismatches") return &thresholds->max_mismatches;
+  if (option == "--jmer-len") return &thresholds->j;
+  if (option == "--min-jmers") return &thresholds->minimum_matching_jmers;
+  if (option == "--min-lcs") return &thresholds->minimum_lcs_threshold;
+  return nullptr;
+}
+
+bool ParseUnsigned(const std::string &option, const std::string &argument,
+    unsigned* value, std::string* error) {
+  char* end = nullptr;
+  unsigned long parsed = 0;
+  if (!argument.empty() && argument[0] >= '0' && argument[0] <= '9') {
+    parsed = strtoul(argument.c_str(), &end, 10);
+  }
+  if (end == nullptr || *end != '\0' || parsed > 0xffffffffull) {
+    *error = option + " needs a whole number, not " + argument;
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool CheckThresholds(const Thresholds &thresholds, std::string* error) {
+  if (thresholds.tail_len < 1 || thresholds.tail_len > max_kmer_len) {
+    *error = "--tail-len must be from 1 to " + std::to_string(max_kmer_len);
+    return false;
+  }
+  if (thresholds.j < 1 || thresholds.j > max_kmer_len) {
+    *error = "--jmer-len must be from 1 to " + std::to_string(max_kmer_len);
+    return false;
+  }
+  return true;
+}
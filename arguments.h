@@ -0,0 +1,29 @@
+#ifndef ARGUMENTS_H
+#define ARGUMENTS_H
+
+#include <string>       // for std::string
+
+// The thresholds of main's three tests, which calibrate also takes to show
+// how the pairs fall under them. Each has the default the constants at the
+// top of main.cc used to have.
+struct Thresholds {
+  unsigned tail_len = 5;
+  unsigned max_mismatches = 1;
+  unsigned j = 5;
+  unsigned minimum_matching_jmers = 3;
+  unsigned minimum_lcs_threshold = 6;
+  bool coarse = false;  // if this is true, one primer of each pair will be parsed end-to-end
+};
+
+// the threshold option of thresholds, such as --tail-len, which takes a
+// number, or nullptr if option is none of them
+unsigned* ThresholdOption(const std::string &option, Thresholds* thresholds);
+// Reads argument, the value of option, into value, returning false with a
+// message in error unless it is a whole decimal number of 32 bits.
+bool ParseUnsigned(const std::string &option, const std::string &argument,
+    unsigned* value, std::string* error);
+// Checks that the tail and j-mer lengths are from 1 to max_kmer_len,
+// returning false with a message in error if not.
+bool CheckThresholds(const Thresholds &thresholds, std::string* error);
+
+#endif
@@ -0,0 +1,290 @@
+#include <math.h>       // for log()
+#include <stdio.h>      // for printf, fopen
+#include <stdlib.h>     // for exit(), strtoul()
+#include <string.h>     // for strcmp()
+#include <sys/resource.h>  // for struct rusage
+#include <sys/wait.h>   // for wait4()
+#include <unistd.h>     // for fork(), pipe(), read(), write()
+
+#include <algorithm>    // for std::min_element, std::max_element
+#include <chrono>       // for std::chrono::steady_clock
+#include <fstream>      // for std::ofstream
+#include <memory>       // for std::unique_ptr
+#include <random>       // for std::mt19937
+#include <string>       // for std::string
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "jmer_matching.h"
+#include "lcs_join.h"
+#include "metrics.h"
+#include "options.h"
+#include "panel_file.h"
+#include "pipeline.h"
+#include "primer_panel.h"
+#include "tail_matching.h"
+
+// The panels screened, smallest first: the bundled test panels, then
+// synthetic panels of random primers whose sizes can be given on the
+// command line instead. Every panel is screened in a child process of its
+// own, so its peak RSS is its own and a panel too large for the machine
+// only loses its own row.
+const char* bundled_panels[] = {
+  "data/test_data_primers_1000_25.txt",
+  "data/test_data_primers_4000_25.txt",
+  "data/test_data_primers_10000_25.txt",
+  "data/test_data_primers_15000_25.txt",
+};
+const unsigned default_synthetic_sizes[] = {20000};
+const unsigned synthetic_primer_len = 25;
+
+// the seconds each stage of main took on one panel
+struct PanelTimes {
+  unsigned primers;
+  double parse;
+  double tail_index;
+  double tail_match;
+  double jmer_index;
+  double jmer_match;
+  double lcs;
+  double output;
+  double total;
+  unsigned long long candidates;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// screens file_name as main does with the default options
+PanelTimes ScreenPanel(const std::string &file_name, unsigned threads) {
+  Options options;
+  PanelTimes times = PanelTimes();
+  auto start = std::chrono::steady_clock::now();
+  auto stage_start = start;
+
+  PrimerPanel primers;
+  std::string error;
+  if (!ReadPanelFile(file_name, &primers, &error)) {
+    printf("%s\n", error.c_str());
+    exit(EXIT_FAILURE);
+  }
+  times.primers = primers.size();
+  times.parse = SecondsSince(stage_start);
+
+  stage_start = std::chrono::steady_clock::now();
+  TailMatcher matcher(primers, options.tail_len, options.max_mismatches,
+      options.tail_index);
+  times.tail_index = SecondsSince(stage_start);
+
+  stage_start = std::chrono::steady_clock::now();
+  CandidatePairs tail_hits = MatchTails(primers, matcher, threads, true);
+  times.tail_match = SecondsSince(stage_start);
+
+  stage_start = std::chrono::steady_clock::now();
+  JmerCounter counter(primers, options.j, options.coarse);
+  times.jmer_index = SecondsSince(stage_start);
+
+  stage_start = std::chrono::steady_clock::now();
+  std::unique_ptr<LcsJoin> lcs_join;
+  if (options.minimum_lcs_threshold > 0
+      && options.lcs_filter != kDpLcsFilter) {
+    lcs_join.reset(new LcsJoin(primers, options.minimum_lcs_threshold,
+        options.lcs_filter));
+  }
+  double lcs_index = SecondsSince(stage_start);
+
+  FilterPipeline pipeline(primers.size());
+  pipeline.AddStage(std::unique_ptr<PairStage>(new TailStage(tail_hits)));
+  pipeline.AddStage(std::unique_ptr<PairStage>(
+      new JmerStage(counter, options.minimum_matching_jmers)));
+  if (lcs_join) {
+    pipeline.AddStage(std::unique_ptr<PairStage>(new LcsJoinStage(*lcs_join)));
+  } else if (options.minimum_lcs_threshold > 0) {
+    pipeline.AddStage(std::unique_ptr<PairStage>(
+        new LcsStage(primers, options.minimum_lcs_threshold)));
+  }
+  // the rows come in order with their partners k >= i, and the partners
+  // k < i are mirrored from the earlier rows, as in main
+  CandidatePairs candidates;
+  std::vector<std::vector<Candidate>> lower(primers.size());
+  Metrics metrics;
+  metrics.BeginStage("filter");
+  pipeline.VisitRows([&](unsigned i, const Candidate* first,
+      const Candidate* last) {
+    std::vector<Candidate> row;
+    row.swap(lower[i]);
+    row.insert(row.end(), first, last);
+    for (const Candidate* candidate = first; candidate != last; ++candidate) {
+      if (candidate->partner == i) continue;
+      Candidate mirrored = *candidate;
+      mirrored.partner = i;
+      lower[candidate->partner].push_back(mirrored);
+    }
+    candidates.AppendRow(row);
+  }, threads);
+  metrics.EndStage();
+  pipeline.RecordMetrics(&metrics);
+  // stage times are summed over the threads
+  times.jmer_match = metrics.Number("jmer_thread_seconds");
+  times.lcs = lcs_index + metrics.Number("lcs_thread_seconds");
+  times.candidates = candidates.size();
+
+  // format the candidates as main does, into nowhere
+  stage_start = std::chrono::steady_clock::now();
+  std::ofstream out("/dev/null");
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    for (unsigned t = 0; t < candidates[i].size(); ++t) {
+      unsigned k = candidates[i][t].partner;
+      if (t == 0) {
+        out << '\n' << primers.Name(i) << " : " << primers.Name(k);
+      } else {
+        out << ", " << primers.Name(k);
+      }
+    }
+  }
+  out.flush();
+  times.output = SecondsSince(stage_start);
+  times.total = SecondsSince(start);
+  return times;
+}
+
+// Screens file_name in a child process, returning false if the child
+// failed. peak_rss_mb is the child's peak resident set size.
+bool ScreenPanelInChild(const std::string &file_name, unsigned threads,
+    PanelTimes* times, double* peak_rss_mb) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    close(fds[0]);
+    PanelTimes child_times = ScreenPanel(file_name, threads);
+    bool ok = write(fds[1], &child_times, sizeof(child_times))
+        == static_cast<ssize_t>(sizeof(child_times));
+    _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  close(fds[1]);
+  bool ok = read(fds[0], times, sizeof(*times))
+      == static_cast<ssize_t>(sizeof(*times));
+  close(fds[0]);
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid) return false;
+  *peak_rss_mb = usage.ru_maxrss / 1024.0;  // ru_maxrss is in kilobytes
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+// writes number_of_primers random primers in the test data format
+void WriteSyntheticPanel(const std::string &file_name,
+    unsigned number_of_primers) {
+  FILE* outfile = fopen(file_name.c_str(), "w");
+  if (outfile == NULL) {
+    printf("can't open %s\n", file_name.c_str());
+    exit(EXIT_FAILURE);
+  }
+  std::mt19937 generator(number_of_primers);
+  fprintf(outfile, "%u\n", number_of_primers);
+  std::string primer(synthetic_primer_len, 'A');
+  for (unsigned i = 0; i < number_of_primers; ++i) {
+    for (char &base : primer) base = DecodeBase(generator() & 3);
+    fprintf(outfile, "%s\n", primer.c_str());
+  }
+  fclose(outfile);
+}
+
+// the least squares slope of log(y) against log(x)
+double ScalingExponent(const std::vector<double> &x,
+    const std::vector<double> &y) {
+  unsigned n = x.size();
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (unsigned p = 0; p < n; ++p) {
+    double lx = log(x[p]);
+    double ly = log(y[p]);
+    sx += lx;
+    sy += ly;
+    sxx += lx * lx;
+    sxy += lx * ly;
+  }
+  double denominator = n * sxx - sx * sx;
+  return denominator > 0 ? (n * sxy - sx * sy) / denominator : 0;
+}
+
+int main(int argc, char* argv[]) {
+  // benchmark [--threads N] [synthetic panel size ...]
+  unsigned threads = 0;
+  std::vector<unsigned> synthetic_sizes;
+  for (int a = 1; a < argc; ++a) {
+    if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+      threads = strtoul(argv[++a], NULL, 10);
+    } else {
+      synthetic_sizes.push_back(strtoul(argv[a], NULL, 10));
+    }
+  }
+  if (synthetic_sizes.empty()) {
+    synthetic_sizes.assign(default_synthetic_sizes,
+        default_synthetic_sizes + sizeof(default_synthetic_sizes)
+            / sizeof(default_synthetic_sizes[0]));
+  }
+
+  std::vector<std::string> panels(bundled_panels, bundled_panels
+      + sizeof(bundled_panels) / sizeof(bundled_panels[0]));
+  std::vector<std::string> synthetic_panels;
+  for (unsigned size : synthetic_sizes) {
+    std::string file_name = "/tmp/primer_dimers_benchmark_"
+        + std::to_string(size) + ".txt";
+    WriteSyntheticPanel(file_name, size);
+    panels.push_back(file_name);
+    synthetic_panels.push_back(file_name);
+  }
+
+  Options options;
+  printf("tail_len = %u, max_mismatches = %u, j = %u, "
+      "minimum_matching_jmers = %u, minimum_lcs_threshold = %u, "
+      "threads = %u\n", options.tail_len, options.max_mismatches, options.j,
+      options.minimum_matching_jmers, options.minimum_lcs_threshold, threads);
+  printf("stage times in seconds; jmer and lcs are summed over the threads\n");
+  printf("+---------+--------+--------+--------+--------+--------+--------+--------+---------+-----------+------------+---------+\n");
+  printf("| primers | parse  | tail   | tail   | jmer   | jmer   | lcs    | output | total   | pairs per | candidates | peak    |\n");
+  printf("|         |        | index  | match  | index  | match  |        |        |         | second    |            | RSS MB  |\n");
+  printf("+---------+--------+--------+--------+--------+--------+--------+--------+---------+-----------+------------+---------+\n");
+  std::vector<double> sizes;
+  std::vector<std::vector<double>> stage_seconds(6);
+  for (const std::string &panel : panels) {
+    PanelTimes times;
+    double peak_rss_mb;
+    if (!ScreenPanelInChild(panel, threads, &times, &peak_rss_mb)) {
+      printf("| %s failed, perhaps for lack of memory\n", panel.c_str());
+      continue;
+    }
+    double pairs = static_cast<double>(times.primers) * times.primers;
+    printf("| %-8u| %-7.3f| %-7.3f| %-7.3f| %-7.3f| %-7.3f| %-7.3f| %-7.3f| %-8.3f| %-10.3g| %-11llu| %-8.1f|\n",
+        times.primers, times.parse, times.tail_index, times.tail_match,
+        times.jmer_index, times.jmer_match, times.lcs, times.output,
+        times.total, pairs / times.total, times.candidates, peak_rss_mb);
+    sizes.push_back(times.primers);
+    double seconds[] = {times.tail_match, times.jmer_match, times.lcs,
+        times.output, times.total, peak_rss_mb};
+    for (unsigned s = 0; s < 6; ++s) stage_seconds[s].push_back(seconds[s]);
+  }
+  printf("+---------+--------+--------+--------+--------+--------+--------+--------+---------+-----------+------------+---------+\n");
+  for (const std::string &file_name : synthetic_panels) {
+    remove(file_name.c_str());
+  }
+
+  // time ~ primers^exponent; 2 is the cost of testing every pair
+  if (sizes.size() >= 2) {
+    const char* names[] = {"tail match", "jmer match", "lcs", "output",
+        "total", "peak RSS"};
+    printf("scaling exponents over %u to %u primers:\n",
+        static_cast<unsigned>(*std::min_element(sizes.begin(), sizes.end())),
+        static_cast<unsigned>(*std::max_element(sizes.begin(), sizes.end())));
+    for (unsigned s = 0; s < 6; ++s) {
+      printf("  %-10s = %.2f\n", names[s],
+          ScalingExponent(sizes, stage_seconds[s]));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>      // for printf
+#include <stdlib.h>     // for exit()
+
+#include <string>       // for std::string
+
+#include "arguments.h"
+#include "jmer_matching.h"
+#include "panel_file.h"
+#include "primer_panel.h"
+#include "sweep.h"
+
+// The tables of 3_prime_end_testing, jmer_counting and lcs_dp for a whole
+// range of parameters in one run, to recalibrate the thresholds of main
+// for a new panel, and how the pairs fall under main's tests with the
+// thresholds chosen, given with main's options and defaults:
+//
+//   calibrate [input_file] [--threads N] [--min-tail-len N]
+//       [--max-tail-len N] [--sweep-mismatches N] [--min-j N] [--max-j N]
+//       [--tail-len N] [--max-mismatches N] [--jmer-len N] [--min-jmers N]
+//       [--min-lcs N] [--coarse]
+const char* default_infile_name = "data/test_data_primers_4000_25.txt";
+
+int main(int argc, char* argv[]) {
+  std::string infile_name = default_infile_name;
+  unsigned threads = 0;
+  unsigned min_tail_len = 5;
+  unsigned max_tail_len = 20;
+  unsigned sweep_mismatches = 4;
+  unsigned min_j = 3;
+  unsigned max_j = max_signature_j;
+  Thresholds thresholds;
+  std::string error;
+  for (int a = 1; a < argc; ++a) {
+    std::string option = argv[a];
+    if (option.compare(0, 2, "--") != 0) {
+      infile_name = option;
+      continue;
+    }
+    if (option == "--coarse") {
+      thresholds.coarse = true;
+      continue;
+    }
+    unsigned* number = ThresholdOption(option, &thresholds);
+    if (option == "--threads") {
+      number = &threads;
+    } else if (option == "--min-tail-len") {
+      number = &min_tail_len;
+    } else if (option == "--max-tail-len") {
+      number = &max_tail_len;
+    } else if (option == "--sweep-mismatches") {
+      number = &sweep_mismatches;
+    } else if (option == "--min-j") {
+      number = &min_j;
+    } else if (option == "--max-j") {
+      number = &max_j;
+    } else if (number == nullptr) {
+      printf("unknown option %s\n", option.c_str());
+      exit(EXIT_FAILURE);
+    }
+    if (a + 1 == argc) {
+      printf("%s needs a value\n", option.c_str());
+      exit(EXIT_FAILURE);
+    }
+    if (!ParseUnsigned(option, argv[++a], number, &error)) {
+      printf("%s\n", error.c_str());
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (max_tail_len > 31 || min_tail_len > max_tail_len) {
+    printf("tail lengths must be at most 31, the smallest first\n");
+    exit(EXIT_FAILURE);
+  }
+  if (min_j < 1 || max_j > max_signature_j || min_j > max_j) {
+    printf("j must be from 1 to %u, the smallest first\n", max_signature_j);
+    exit(EXIT_FAILURE);
+  }
+  if (!CheckThresholds(thresholds, &error)) {
+    printf("%s\n", error.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  // read input file
+  PrimerPanel panel;
+  if (!ReadPanelFile(infile_name, &panel, &error)) {
+    printf("%s\n", error.c_str());
+    exit(EXIT_FAILURE);
+  }
+  printf("input_file_name = %s\n", infile_name.c_str());
+  printf("number_of_primers = %u\n", panel.size());
+  printf("primer_len = %u\n", panel.MaxLength());
+
+  // every tail length and number of mismatches from one sweep
+  printf("\n");
+  PrintTailSweep(panel, min_tail_len, max_tail_len, sweep_mismatches, threads);
+
+  for (unsigned j = min_j; j <= max_j; ++j) {
+    printf("\n");
+    printf("j (the length of a j-mer) = %u\n", j);
+    PrintJmerSweep(panel, j, threads);
+  }
+
+  // every lcs threshold from one sweep
+  printf("\n");
+  PrintLcsSweep(panel, threads);
+
+  // the pairs under all three tests of main at once
+  printf("\n");
+  printf("tail_len = %u, max_mismatches = %u, j = %u, coarse = %d\n",
+      thresholds.tail_len, thresholds.max_mismatches, thresholds.j,
+      thresholds.coarse);
+  printf("minimum_matching_jmers = %u, minimum_lcs_threshold = %u\n",
+      thresholds.minimum_matching_jmers, thresholds.minimum_lcs_threshold);
+  PrintJointSweep(panel, thresholds.tail_len, thresholds.max_mismatches,
+      thresholds.j, thresholds.coarse, thresholds.minimum_matching_jmers,
+      thresholds.minimum_lcs_threshold, threads);
+
+  return 0;
+}
@@ -0,0 +1,84 @@
+#include "candidate_pairs.h"
+
+#include <algorithm>    // for std::lower_bound
+
+void CandidatePairs::AppendRow(const Candidate* first, const Candidate* last) {
+  candidates_.insert(candidates_.end(), first, last);
+  row_offsets_.push_back(candidates_.size());
+}
+
+void CandidatePairs::AppendRows(const CandidatePairs &rows) {
+  size_t base = candidates_.size();
+  candidates_.insert(candidates_.end(), rows.candidates_.begin(),
+      rows.candidates_.end());
+  for (unsigned i = 1; i < rows.row_offsets_.size(); ++i) {
+    row_offsets_.push_back(base + rows.row_offsets_[i]);
+  }
+}
+
+CandidatePairs CandidatePairs::Symmetric() const {
+  return Mirrored(false);
+}
+
+CandidatePairs CandidatePairs::UpperTriangle() const {
+  return Mirrored(true);
+}
+
+CandidatePairs CandidatePairs::Mirrored(bool upper) const {
+  // transpose with a counting pass; walking the rows in order leaves every
+  // transposed row sorted. For the upper triangle only the pairs below the
+  // diagonal are transposed, and only those on or above it kept.
+  unsigned rows = Rows();
+  std::vector<size_t> transposed_offsets(rows + 1, 0);
+  for (unsigned i = 0; i < rows; ++i) {
+    for (const Candidate &candidate : (*this)[i]) {
+      if (!upper || candidate.partner < i) {
+        ++transposed_offsets[candidate.partner + 1];
+      }
+    }
+  }
+  for (unsigned i = 0; i < rows; ++i) {
+    transposed_offsets[i + 1] += transposed_offsets[i];
+  }
+  std::vector<Candidate> transposed(transposed_offsets[rows]);
+  std::vector<size_t> next(transposed_offsets.begin(),
+      transposed_offsets.end() - 1);
+  for (unsigned i = 0; i < rows; ++i) {
+    for (const Candidate &candidate : (*this)[i]) {
+      if (upper && candidate.partner >= i) continue;
+      Candidate mirrored = candidate;
+      mirrored.partner = i;
+      transposed[next[candidate.partner]++] = mirrored;
+    }
+  }
+
+  // merge every row with its transposed row
+  CandidatePairs symmetric;
+  symmetric.row_offsets_.reserve(rows + 1);
+  symmetric.candidates_.reserve(candidates_.size());
+  std::vector<Candidate> &merged = symmetric.candidates_;
+  for (unsigned i = 0; i < rows; ++i) {
+    const Candidate* a = candidates_.data() + row_offsets_[i];
+    if (upper) {
+      a = std::lower_bound(a, candidates_.data() + row_offsets_[i + 1], i,
+          [](const Candidate &candidate, unsigned partner) {
+            return candidate.partner < partner;
+          });
+    }
+    const Candidate* a_end = candidates_.data() + row_offsets_[i + 1];
+    const Candidate* b = transposed.data() + transposed_offsets[i];
+    const Candidate* b_end = transposed.data() + transposed_offsets[i + 1];
+    while (a != a_end || b != b_end) {
+      if (b == b_end || (a != a_end && a->partner < b->partner)) {
+        merged.push_back(*a++);
+      } else if (a == a_end || b->partner < a->partner) {
+        merged.push_back(*b++);
+      } else {
+        merged.push_back(*a++);
+        ++b;
+      }
+    }
+    symmetric.row_offsets_.push_back(merged.size());
+  }
+  return symmetric;
+}
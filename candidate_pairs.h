@@ -0,0 +1,70 @@
+#ifndef CANDIDATE_PAIRS_H
+#define CANDIDATE_PAIRS_H
+
+#include <stddef.h>     // for size_t
+#include <stdint.h>     // for uint16_t
+
+#include <vector>       // for std::vector
+
+// A partner of a primer in a set of candidate pairs, with the scores which
+// have been computed for the pair so far.
+struct Candidate {
+  unsigned partner;
+  uint16_t jmers;
+  uint16_t lcs_len;
+};
+
+// Candidate pairs in compressed sparse row form: the partners of primer i
+// are stored contiguously in increasing order, so memory grows with the
+// number of candidates rather than with the square of the panel size.
+class CandidatePairs {
+ public:
+  class Row {
+   public:
+    Row(const Candidate* first, const Candidate* last)
+        : first_(first), last_(last) {}
+    const Candidate* begin() const { return first_; }
+    const Candidate* end() const { return last_; }
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return first_ == last_; }
+    const Candidate &operator[](size_t t) const { return first_[t]; }
+
+   private:
+    const Candidate* first_;
+    const Candidate* last_;
+  };
+
+  unsigned Rows() const {
+    return row_offsets_.size() - 1;
+  }
+  // the total number of pairs
+  size_t size() const {
+    return candidates_.size();
+  }
+  Row operator[](unsigned i) const {
+    return Row(candidates_.data() + row_offsets_[i],
+        candidates_.data() + row_offsets_[i + 1]);
+  }
+
+  // adds the partners of the next primer, which must be in increasing order
+  void AppendRow(const Candidate* first, const Candidate* last);
+  void AppendRow(const std::vector<Candidate> &row) {
+    AppendRow(row.data(), row.data() + row.size());
+  }
+  // adds all the rows of rows after the rows already present
+  void AppendRows(const CandidatePairs &rows);
+  // The union of these pairs with their mirror images: (k, i) is added with
+  // the scores of (i, k) wherever only (i, k) is present.
+  CandidatePairs Symmetric() const;
+  // the pairs (i, k) of Symmetric() with i <= k, without the lower half
+  CandidatePairs UpperTriangle() const;
+
+ private:
+  // Symmetric(), keeping only the upper triangle if upper is true
+  CandidatePairs Mirrored(bool upper) const;
+
+  std::vector<size_t> row_offsets_ = std::vector<size_t>(1, 0);
+  std::vector<Candidate> candidates_;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "incremental_screen.h"
+
+#include <algorithm>    // for std::sort, std::unique, std::lower_bound
+#include <utility>      // for std::swap
+
+#include "lcs.h"
+#include "parallel.h"
+
+IncrementalScreen::IncrementalScreen(const ScreenParameters &parameters,
+    unsigned threads, const PrimerPanel &primers,
+    const CandidatePairs &candidates)
+    : parameters_(parameters), threads_(threads), primers_(primers),
+      removed_(primers.size(), false) {
+  for (unsigned i = 0; i < primers_.size(); ++i) {
+    AddPrimer(i);
+    rows_[i].assign(candidates[i].begin(), candidates[i].end());
+  }
+  // the join only tests the lcs threshold; give the pairs screened before
+  // the lcs that ScreenRow gives the new ones
+  std::vector<unsigned> firsts = UniformRowBlocks(primers_.size(),
+      16 * ResolveThreads(threads_));
+  ParallelForBlocks(firsts.size() - 1, threads_, [&](unsigned b, unsigned) {
+    std::vector<unsigned> partners;
+    std::vector<unsigned> lcs_lens;
+    for (unsigned i = firsts[b]; i < firsts[b + 1]; ++i) {
+      std::vector<Candidate> &row = rows_[i];
+      partners.clear();
+      for (const Candidate &candidate : row) {
+        if (candidate.lcs_len == 0) partners.push_back(candidate.partner);
+      }
+      if (partners.empty()) continue;
+      lcs_lens.resize(partners.size());
+      LcsLenBatch(primers_, i, partners.data(), partners.size(),
+          lcs_lens.data());
+      unsigned t = 0;
+      for (Candidate &candidate : row) {
+        if (candidate.lcs_len == 0) candidate.lcs_len = lcs_lens[t++];
+      }
+    }
+  });
+}
+
+void IncrementalScreen::AddPrimer(unsigned i) {
+  unsigned tail_len = parameters_.tail_len;
+  unsigned j = parameters_.j;
+  unsigned len = primers_.Length(i);
+  // the reverse complement of the tail is the start of the packed rc
+  kmer_t tail = 0;
+  if (len >= tail_len) {
+    for (unsigned p = 0; p < tail_len; ++p) {
+      tail = (tail << 2) | primers_.RcBase(i, p);
+    }
+  }
+  tails_.push_back(tail);
+  windows_.emplace_back();
+  ForEachKmer(primers_, i, tail_len, [&](unsigned, kmer_t window, kmer_t) {
+    windows_.back().push_back(window);
+  });
+
+  // the distinct j-mers, with the rc ones parsed as JmerSignatures does
+  std::vector<kmer_t> jmers;
+  std::vector<kmer_t> rc_jmers;
+  ForEachKmer(primers_, i, j, [&](unsigned start, kmer_t jmer, kmer_t jmer_rc) {
+    jmers.push_back(jmer);
+    if (!parameters_.coarse || (len - j - start) % j == 0) {
+      rc_jmers.push_back(jmer_rc);
+    }
+  });
+  std::sort(jmers.begin(), jmers.end());
+  jmers.erase(std::unique(jmers.begin(), jmers.end()), jmers.end());
+  std::sort(rc_jmers.begin(), rc_jmers.end());
+  rc_jmers.erase(std::unique(rc_jmers.begin(), rc_jmers.end()),
+      rc_jmers.end());
+  jmers_.push_back(std::move(jmers));
+  rc_jmers_.push_back(std::move(rc_jmers));
+  rows_.emplace_back();
+}
+
+bool IncrementalScreen::TailInWindow(unsigned i, unsigned k) const {
+  unsigned tail_len = parameters_.tail_len;
+  if (primers_.Length(k) < tail_len) return false;
+  for (kmer_t window : windows_[i]) {
+    kmer_t x = window ^ tails_[k];
+    if ((x >> (2 * (tail_len - 1))) == 0
+        && BaseMismatches(x) <= parameters_.max_mismatches) {
+      return true;
+    }
+  }
+  return false;
+}
+
+unsigned IncrementalScreen::SharedJmers(unsigned i, unsigned k) const {
+  if (k < i) std::swap(i, k);
+  const std::vector<kmer_t> &a = rc_jmers_[i];
+  const std::vector<kmer_t> &b = jmers_[k];
+  unsigned shared = 0;
+  for (unsigned s = 0, t = 0; s < a.size() && t < b.size();) {
+    if (a[s] < b[t]) {
+      ++s;
+    } else if (b[t] < a[s]) {
+      ++t;
+    } else {
+      ++shared;
+      ++s;
+      ++t;
+    }
+  }
+  return shared;
+}
+
+void IncrementalScreen::ScreenRow(unsigned i,
+    std::vector<Candidate>* row) const {
+  row->clear();
+  for (unsigned k = 0; k < primers_.size(); ++k) {
+    if (removed_[k] || !(TailInWindow(i, k) || TailInWindow(k, i))) continue;
+    unsigned jmers = SharedJmers(i, k);
+    if (jmers < parameters_.minimum_matching_jmers) continue;
+    row->push_back({k, static_cast<uint16_t>(jmers), 0});
+  }
+  std::vector<unsigned> partners(row->size());
+  std::vector<unsigned> lcs_lens(row->size());
+  for (unsigned t = 0; t < row->size(); ++t) partners[t] = (*row)[t].partner;
+  LcsLenBatch(primers_, i, partners.data(), partners.size(), lcs_lens.data());
+  unsigned kept = 0;
+  for (unsigned t = 0; t < row->size(); ++t) {
+    if (lcs_lens[t] < parameters_.minimum_lcs_threshold) continue;
+    (*row)[kept] = (*row)[t];
+    (*row)[kept++].lcs_len = lcs_lens[t];
+  }
+  row->resize(kept);
+}
+
+void IncrementalScreen::Append(const PrimerPanel &added) {
+  unsigned first = primers_.size();
+  for (unsigned a = 0; a < added.size(); ++a) {
+    primers_.Append(added.Name(a), added.Sequence(a));
+    removed_.push_back(false);
+    AddPrimer(first + a);
+  }
+
+  // screen the new rows in parallel, then mirror their pairs with the old
+  // primers into the old rows; the new partners are larger than any old
+  // one, so the old rows stay sorted
+  std::vector<unsigned> firsts = UniformRowBlocks(added.size(),
+      16 * ResolveThreads(threads_));
+  ParallelForBlocks(firsts.size() - 1, threads_, [&](unsigned b, unsigned) {
+    for (unsigned a = firsts[b]; a < firsts[b + 1]; ++a) {
+      ScreenRow(first + a, &rows_[first + a]);
+    }
+  });
+  for (unsigned i = first; i < primers_.size(); ++i) {
+    for (const Candidate &candidate : rows_[i]) {
+      if (candidate.partner >= first) break;
+      Candidate mirrored = candidate;
+      mirrored.partner = i;
+      rows_[candidate.partner].push_back(mirrored);
+    }
+  }
+}
+
+void IncrementalScreen::Remove(unsigned i) {
+  if (removed_[i]) return;
+  for (const Candidate &candidate : rows_[i]) {
+    if (candidate.partner == i) continue;
+    std::vector<Candidate> &row = rows_[candidate.partner];
+    auto it = std::lower_bound(row.begin(), row.end(), i,
+        [](const Candidate &c, unsigned partner) {
+          return c.partner < partner;
+        });
+    if (it != row.end() && it->partner == i) row.erase(it);
+  }
+  removed_[i] = true;
+  std::vector<Candidate>().swap(rows_[i]);
+  std::vector<kmer_t>().swap(windows_[i]);
+  std::vector<kmer_t>().swap(jmers_[i]);
+  std::vector<kmer_t>().swap(rc_jmers_[i]);
+}
+
+CandidatePairs IncrementalScreen::Candidates() const {
+  CandidatePairs candidates;
+  for (const std::vector<Candidate> &row : rows_) candidates.AppendRow(row);
+  return candidates;
+}
@@ -0,0 +1,72 @@
+#ifndef INCREMENTAL_SCREEN_H
+#define INCREMENTAL_SCREEN_H
+
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "kmer.h"
+#include "primer_panel.h"
+
+// The thresholds a panel is screened with, as given on the command line.
+struct ScreenParameters {
+  unsigned tail_len;
+  unsigned max_mismatches;
+  unsigned j;
+  unsigned minimum_matching_jmers;
+  unsigned minimum_lcs_threshold;
+  bool coarse;
+};
+
+// A screened panel which primers can be appended to and removed from
+// without screening the existing pairs again. Every primer keeps its packed
+// tail, its tail_len windows and its sorted distinct j-mers, which are all
+// that the tail and j-mer tests of a single pair need, so appending d
+// primers to a panel of n tests only the d * (n + d) new pairs, with the
+// same tests and thresholds as MatchTails and the filter pipeline.
+class IncrementalScreen {
+ public:
+  // a screen of primers whose pairs have already been screened, with the
+  // same parameters, into candidates; pairs without their lcs get it
+  IncrementalScreen(const ScreenParameters &parameters, unsigned threads,
+      const PrimerPanel &primers, const CandidatePairs &candidates);
+
+  // Appends the primers of added after those already in the panel and
+  // screens their pairs with every primer not removed, themselves included.
+  void Append(const PrimerPanel &added);
+  // Removes primer i and all its pairs, leaving the candidates a screen of
+  // the panel without it would give. The other primers keep their indexes.
+  void Remove(unsigned i);
+
+  const PrimerPanel &Primers() const {
+    return primers_;
+  }
+  bool Removed(unsigned i) const {
+    return removed_[i];
+  }
+  // the candidates of primer i, in increasing order of partner
+  const std::vector<Candidate> &Row(unsigned i) const {
+    return rows_[i];
+  }
+  CandidatePairs Candidates() const;
+
+ private:
+  void AddPrimer(unsigned i);
+  // whether the tail of primer k is close enough to a window of primer i
+  bool TailInWindow(unsigned i, unsigned k) const;
+  // the number of j-mers of rc(primer min(i, k)) also in primer max(i, k)
+  unsigned SharedJmers(unsigned i, unsigned k) const;
+  // the candidates of new primer i with every primer not removed
+  void ScreenRow(unsigned i, std::vector<Candidate>* row) const;
+
+  ScreenParameters parameters_;
+  unsigned threads_;
+  PrimerPanel primers_;
+  std::vector<bool> removed_;
+  std::vector<kmer_t> tails_;
+  std::vector<std::vector<kmer_t>> windows_;
+  std::vector<std::vector<kmer_t>> jmers_;
+  std::vector<std::vector<kmer_t>> rc_jmers_;
+  std::vector<std::vector<Candidate>> rows_;
+};
+
+#endif
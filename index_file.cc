@@ -0,0 +1,98 @@
+#include "index_file.h"
+
+#include <fcntl.h>      // for open()
+#include <stdio.h>      // for fopen(), fwrite()
+#include <stdlib.h>     // for exit()
+#include <string.h>     // for memcmp()
+#include <sys/mman.h>   // for mmap(), munmap()
+#include <sys/stat.h>   // for fstat()
+#include <unistd.h>     // for close()
+
+#include <fstream>      // for std::ifstream
+#include <iostream>     // for std::cout
+
+uint64_t IndexChecksum(const uint64_t* words, size_t n) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t w = 0; w < n; ++w) {
+    hash ^= words[w];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool IndexWriter::Save(const std::string &file_name,
+    IndexFileHeader header) const {
+  std::copy(index_file_magic, index_file_magic + 8, header.magic);
+  header.version = index_file_version;
+  header.payload_words = payload_.size();
+  header.checksum = IndexChecksum(payload_.data(), payload_.size());
+  FILE* file = fopen(file_name.c_str(), "wb");
+  if (file == NULL) return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+      && fwrite(payload_.data(), sizeof(uint64_t), payload_.size(), file)
+          == payload_.size();
+  return fclose(file) == 0 && ok;
+}
+
+IndexReader::~IndexReader() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_bytes_);
+}
+
+bool IndexReader::Open(const std::string &file_name, std::string* error) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "could not open " + file_name;
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0
+      || static_cast<size_t>(status.st_size) < sizeof(IndexFileHeader)) {
+    close(fd);
+    *error = file_name + " is too short to be an index file";
+    return false;
+  }
+  mapping_bytes_ = status.st_size;
+  void* mapping = mmap(nullptr, mapping_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    *error = "could not map " + file_name;
+    return false;
+  }
+  mapping_ = mapping;
+
+  const IndexFileHeader &header = Header();
+  if (memcmp(header.magic, index_file_magic, 8) != 0) {
+    *error = file_name + " is not an index file";
+    return false;
+  }
+  if (header.version != index_file_version) {
+    *error = file_name + " has an unsupported index version";
+    return false;
+  }
+  payload_ = reinterpret_cast<const uint64_t*>(
+      static_cast<const char*>(mapping_) + sizeof(IndexFileHeader));
+  payload_words_ = (mapping_bytes_ - sizeof(IndexFileHeader)) / 8;
+  if (header.payload_words != payload_words_
+      || header.checksum != IndexChecksum(payload_, payload_words_)) {
+    *error = file_name + " is truncated or corrupt";
+    return false;
+  }
+  next_ = 0;
+  return true;
+}
+
+const uint64_t* IndexReader::Take(size_t words) {
+  if (words > payload_words_ - next_) {
+    std::cout << "Index file ends early.\n";
+    std::exit(EXIT_FAILURE);
+  }
+  const uint64_t* taken = payload_ + next_;
+  next_ += words;
+  return taken;
+}
+
+bool IsIndexFile(const std::string &file_name) {
+  std::ifstream instream(file_name, std::ios::binary);
+  char magic[8];
+  return instream.read(magic, 8) && memcmp(magic, index_file_magic, 8) == 0;
+}
@@ -0,0 +1,112 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include <stddef.h>     // for size_t
+#include <stdint.h>     // for uint32_t, uint64_t
+
+#include <algorithm>    // for std::copy
+#include <string>       // for std::string
+#include <vector>       // for std::vector
+
+#include "mapped_array.h"
+
+// The layout of a binary index file: this header, then a payload of 64-bit
+// words holding values and arrays in the order they were written. Each
+// array is its element count followed by its elements, padded to a whole
+// word, so every array in a mapped file is suitably aligned. Words are in
+// the byte order of the machine which wrote the file.
+struct IndexFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t tail_len;
+  uint32_t max_mismatches;
+  uint32_t j;
+  uint32_t coarse;
+  uint32_t tail_index;
+  uint64_t payload_words;
+  uint64_t checksum;      // of the payload words
+  uint64_t reserved[2];
+};
+
+const char index_file_magic[8] = {'P', 'D', 'I', 'M', 'E', 'R', 'I', 'X'};
+const uint32_t index_file_version = 1;
+
+// a 64-bit FNV-1a style hash of n words
+uint64_t IndexChecksum(const uint64_t* words, size_t n);
+
+// Collects the payload of an index file in memory and saves it.
+class IndexWriter {
+ public:
+  void WriteValue(uint64_t value) {
+    payload_.push_back(value);
+  }
+  template <typename T>
+  void WriteArray(const T* data, size_t size);
+  template <typename T>
+  void WriteArray(const MappedArray<T> &array) {
+    WriteArray(array.data(), array.size());
+  }
+  // writes header, which gets the size and checksum of the payload, then
+  // the payload; returns false if the file cannot be written
+  bool Save(const std::string &file_name, IndexFileHeader header) const;
+
+ private:
+  std::vector<uint64_t> payload_;
+};
+
+// Maps an index file read-only and hands out its values and arrays in the
+// order they were written. Arrays are views into the mapping, so whatever
+// reads them must not outlive the reader. Any number of processes can map
+// the same file and share its pages.
+class IndexReader {
+ public:
+  IndexReader() {}
+  IndexReader(const IndexReader &) = delete;
+  IndexReader &operator=(const IndexReader &) = delete;
+  ~IndexReader();
+
+  // Maps file_name and checks its magic, version and checksum, returning
+  // false with a message in error if any is wrong.
+  bool Open(const std::string &file_name, std::string* error);
+  const IndexFileHeader &Header() const {
+    return *reinterpret_cast<const IndexFileHeader*>(mapping_);
+  }
+  uint64_t ReadValue() {
+    return *Take(1);
+  }
+  template <typename T>
+  void ReadArray(MappedArray<T>* array);
+
+ private:
+  // the next words of the payload; exits if the payload is too short
+  const uint64_t* Take(size_t words);
+
+  void* mapping_ = nullptr;
+  size_t mapping_bytes_ = 0;
+  const uint64_t* payload_ = nullptr;
+  size_t payload_words_ = 0;
+  size_t next_ = 0;
+};
+
+// whether file_name starts with the magic of an index file
+bool IsIndexFile(const std::string &file_name);
+
+template <typename T>
+void IndexWriter::WriteArray(const T* data, size_t size) {
+  payload_.push_back(size);
+  size_t first = payload_.size();
+  size_t bytes = size * sizeof(T);
+  payload_.resize(first + (bytes + 7) / 8, 0);
+  const char* source = reinterpret_cast<const char*>(data);
+  std::copy(source, source + bytes,
+      reinterpret_cast<char*>(payload_.data() + first));
+}
+
+template <typename T>
+void IndexReader::ReadArray(MappedArray<T>* array) {
+  size_t size = ReadValue();
+  const uint64_t* words = Take((size * sizeof(T) + 7) / 8);
+  array->View(reinterpret_cast<const T*>(words), size);
+}
+
+#endif
@@ -0,0 +1,373 @@
+#include "jmer_matching.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>  // for AVX2 intrinsics
+#endif
+
+#include <algorithm>    // for std::sort, std::unique, std::lower_bound, std::min
+#include <utility>      // for std::pair
+
+#include "index_file.h"
+
+JmerSignatures::JmerSignatures(const PrimerPanel &primers, unsigned j,
+    bool rc, bool coarse)
+    : number_of_primers_(primers.size()),
+      words_per_primer_((KmerCount(j) + 63) / 64),
+      words_(static_cast<size_t>(primers.size()) * words_per_primer_, 0) {
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    uint64_t* signature = &words_[static_cast<size_t>(i) * words_per_primer_];
+    unsigned len = primers.Length(i);
+    ForEachKmer(primers, i, j, [&](unsigned start, kmer_t jmer, kmer_t jmer_rc) {
+      // when parsing coarse only every j-th window of the (possibly reverse
+      // complemented) primer is used, counting from its 5' end
+      unsigned start_index = rc ? len - j - start : start;
+      if (coarse && start_index % j != 0) return;
+      kmer_t code = rc ? jmer_rc : jmer;
+      signature[code / 64] |= 1ull << (code % 64);
+    });
+  }
+}
+
+JmerIndex::JmerIndex(const PrimerPanel &primers, unsigned j, bool coarse) {
+  // collect the distinct forward and rc j-mers of every primer
+  std::vector<std::pair<kmer_t, unsigned>> entries;
+  std::vector<kmer_t> rc_codes;
+  std::vector<unsigned> rc_code_offsets(1, 0);
+  std::vector<kmer_t> jmers;
+  std::vector<kmer_t> jmers_rc;
+  primer_offsets_.push_back(0);
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    unsigned len = primers.Length(i);
+    jmers.clear();
+    jmers_rc.clear();
+    ForEachKmer(primers, i, j, [&](unsigned start, kmer_t jmer, kmer_t jmer_rc) {
+      jmers.push_back(jmer);
+      if (!coarse || (len - j - start) % j == 0) jmers_rc.push_back(jmer_rc);
+    });
+    std::sort(jmers.begin(), jmers.end());
+    jmers.erase(std::unique(jmers.begin(), jmers.end()), jmers.end());
+    for (kmer_t jmer : jmers) entries.push_back(std::make_pair(jmer, i));
+    primer_codes_.append(jmers.begin(), jmers.end());
+    primer_offsets_.push_back(primer_codes_.size());
+    std::sort(jmers_rc.begin(), jmers_rc.end());
+    jmers_rc.erase(std::unique(jmers_rc.begin(), jmers_rc.end()),
+        jmers_rc.end());
+    rc_codes.insert(rc_codes.end(), jmers_rc.begin(), jmers_rc.end());
+    rc_code_offsets.push_back(rc_codes.size());
+  }
+
+  // group the forward j-mers into posting lists, primers in increasing order
+  std::sort(entries.begin(), entries.end());
+  posting_offsets_.push_back(0);
+  for (size_t e = 0; e < entries.size(); ++e) {
+    if (e == 0 || entries[e].first != entries[e - 1].first) {
+      if (e != 0) posting_offsets_.push_back(postings_.size());
+      codes_.push_back(entries[e].first);
+    }
+    postings_.push_back(entries[e].second);
+  }
+  if (!entries.empty()) posting_offsets_.push_back(postings_.size());
+
+  // resolve the rc j-mers of each primer to posting lists once, dropping
+  // those which occur in no primer
+  rc_offsets_.push_back(0);
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    for (unsigned e = rc_code_offsets[i]; e < rc_code_offsets[i + 1]; ++e) {
+      auto it = std::lower_bound(codes_.begin(), codes_.end(), rc_codes[e]);
+      if (it != codes_.end() && *it == rc_codes[e]) {
+        rc_lists_.push_back(it - codes_.begin());
+      }
+    }
+    rc_offsets_.push_back(rc_lists_.size());
+  }
+}
+
+JmerSignatures::JmerSignatures(IndexReader* reader) {
+  number_of_primers_ = reader->ReadValue();
+  words_per_primer_ = reader->ReadValue();
+  reader->ReadArray(&words_);
+}
+
+void JmerSignatures::Save(IndexWriter* writer) const {
+  writer->WriteValue(number_of_primers_);
+  writer->WriteValue(words_per_primer_);
+  writer->WriteArray(words_);
+}
+
+JmerIndex::JmerIndex(IndexReader* reader) {
+  reader->ReadArray(&primer_offsets_);
+  reader->ReadArray(&primer_codes_);
+  reader->ReadArray(&codes_);
+  reader->ReadArray(&posting_offsets_);
+  reader->ReadArray(&postings_);
+  reader->ReadArray(&rc_offsets_);
+  reader->ReadArray(&rc_lists_);
+}
+
+void JmerIndex::Save(IndexWriter* writer) const {
+  writer->WriteArray(primer_offsets_);
+  writer->WriteArray(primer_codes_);
+  writer->WriteArray(codes_);
+  writer->WriteArray(posting_offsets_);
+  writer->WriteArray(postings_);
+  writer->WriteArray(rc_offsets_);
+  writer->WriteArray(rc_lists_);
+}
+
+void JmerIndex::CountShared(unsigned i, unsigned first, unsigned last,
+    std::vector<unsigned>* partners) const {
+  for (unsigned e = rc_offsets_[i]; e < rc_offsets_[i + 1]; ++e) {
+    unsigned list = rc_lists_[e];
+    auto end = postings_.begin() + posting_offsets_[list + 1];
+    auto it = std::lower_bound(postings_.begin() + posting_offsets_[list],
+        end, first);
+    for (; it != end && *it < last; ++it) partners->push_back(*it);
+  }
+}
+
+unsigned JmerIndex::SharedJmers(unsigned i, unsigned k) const {
+  // both lists are sorted, so intersect them in one merge
+  unsigned shared = 0;
+  unsigned e = rc_offsets_[i];
+  unsigned f = primer_offsets_[k];
+  while (e < rc_offsets_[i + 1] && f < primer_offsets_[k + 1]) {
+    kmer_t rc_code = codes_[rc_lists_[e]];
+    if (rc_code < primer_codes_[f]) {
+      ++e;
+    } else if (primer_codes_[f] < rc_code) {
+      ++f;
+    } else {
+      ++shared;
+      ++e;
+      ++f;
+    }
+  }
+  return shared;
+}
+
+JmerCounter::JmerCounter(const PrimerPanel &primers, unsigned j,
+    bool coarse) {
+  if (j > max_signature_j) {
+    index_.reset(new JmerIndex(primers, j, coarse));
+  } else {
+    signatures_.reset(new JmerSignatures(primers, j, false, false));
+    rc_signatures_.reset(new JmerSignatures(primers, j, true, coarse));
+  }
+}
+
+JmerCounter::JmerCounter(IndexReader* reader) {
+  if (reader->ReadValue()) {
+    index_.reset(new JmerIndex(reader));
+  } else {
+    signatures_.reset(new JmerSignatures(reader));
+    rc_signatures_.reset(new JmerSignatures(reader));
+  }
+}
+
+size_t JmerCounter::Entries() const {
+  if (index_) return index_->Entries();
+  size_t entries = 0;
+  for (const JmerSignatures* signatures :
+      {signatures_.get(), rc_signatures_.get()}) {
+    for (unsigned i = 0; i < signatures->size(); ++i) {
+      entries += PopcountAnd(signatures->Signature(i), signatures->Signature(i),
+          signatures->WordsPerPrimer());
+    }
+  }
+  return entries;
+}
+
+size_t JmerCounter::BytesPerPrimer() const {
+  if (index_) {
+    return index_->size() ? index_->Entries() * sizeof(kmer_t) / 2
+        / index_->size() : 0;
+  }
+  return signatures_->WordsPerPrimer() * sizeof(uint64_t);
+}
+
+void JmerCounter::Save(IndexWriter* writer) const {
+  writer->WriteValue(index_ != nullptr);
+  if (index_) {
+    index_->Save(writer);
+  } else {
+    signatures_->Save(writer);
+    rc_signatures_->Save(writer);
+  }
+}
+
+namespace {
+
+typedef unsigned (*PopcountAndFn)(const uint64_t*, const uint64_t*, unsigned);
+
+unsigned PopcountAndGeneric(const uint64_t* a, const uint64_t* b,
+    unsigned n) {
+  unsigned count = 0;
+  for (unsigned w = 0; w < n; ++w) count += __builtin_popcountll(a[w] & b[w]);
+  return count;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+unsigned PopcountAndPopcnt(const uint64_t* a, const uint64_t* b, unsigned n) {
+  unsigned count = 0;
+  for (unsigned w = 0; w < n; ++w) count += __builtin_popcountll(a[w] & b[w]);
+  return count;
+}
+
+// AND four words at a time and count bits with the nibble lookup method:
+// vpshufb looks up the popcount of every nibble and vpsadbw sums the bytes
+// into four 64-bit lanes. n is an unsigned or a FixedLength.
+template <typename Words>
+__attribute__((target("avx2,popcnt")))
+inline unsigned PopcountAndAvx2Words(const uint64_t* a, const uint64_t* b,
+    Words n) {
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  unsigned w = 0;
+  for (; w + 4 <= n; w += 4) {
+    __m256i v = _mm256_and_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w)));
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+        _mm256_shuffle_epi8(lookup, hi));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+  uint64_t count = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+      _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+  for (; w < n; ++w) count += __builtin_popcountll(a[w] & b[w]);
+  return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+unsigned PopcountAndAvx2(const uint64_t* a, const uint64_t* b, unsigned n) {
+  return PopcountAndAvx2Words(a, b, n);
+}
+#endif
+
+PopcountAndFn SelectPopcountAnd() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return PopcountAndAvx2;
+  if (__builtin_cpu_supports("popcnt")) return PopcountAndPopcnt;
+#endif
+  return PopcountAndGeneric;
+}
+
+const PopcountAndFn popcount_and = SelectPopcountAnd();
+
+}  // namespace
+
+unsigned PopcountAnd(const uint64_t* a, const uint64_t* b, unsigned n) {
+  return popcount_and(a, b, n);
+}
+
+namespace {
+
+#if defined(__x86_64__)
+// Set the jmers of every candidate of row i from signatures of kWords
+// words each. Signatures of a few words are counted fastest with a popcnt
+// per word, longer ones four words at a time.
+template <unsigned kWords>
+__attribute__((target("popcnt")))
+void CountSignatureRowPopcnt(const JmerSignatures &rc_signatures,
+    const JmerSignatures &signatures, unsigned i,
+    std::vector<Candidate>* row) {
+  const uint64_t* rc_words = rc_signatures.Signature(0);
+  const uint64_t* fwd_words = signatures.Signature(0);
+  for (Candidate &candidate : *row) {
+    const uint64_t* a =
+        rc_words + static_cast<size_t>(std::min(i, candidate.partner)) * kWords;
+    const uint64_t* b =
+        fwd_words + static_cast<size_t>(std::max(i, candidate.partner)) * kWords;
+    unsigned count = 0;
+    for (unsigned w = 0; w < kWords; ++w) {
+      count += __builtin_popcountll(a[w] & b[w]);
+    }
+    candidate.jmers = count;
+  }
+}
+
+template <unsigned kWords>
+__attribute__((target("avx2,popcnt")))
+void CountSignatureRowAvx2(const JmerSignatures &rc_signatures,
+    const JmerSignatures &signatures, unsigned i,
+    std::vector<Candidate>* row) {
+  const uint64_t* rc_words = rc_signatures.Signature(0);
+  const uint64_t* fwd_words = signatures.Signature(0);
+  for (Candidate &candidate : *row) {
+    const uint64_t* a =
+        rc_words + static_cast<size_t>(std::min(i, candidate.partner)) * kWords;
+    const uint64_t* b =
+        fwd_words + static_cast<size_t>(std::max(i, candidate.partner)) * kWords;
+    candidate.jmers = PopcountAndAvx2Words(a, b, FixedLength<kWords>());
+  }
+}
+
+bool UsePopcnt() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("popcnt");
+}
+
+bool UseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+
+const bool use_popcnt = UsePopcnt();
+const bool use_avx2 = UseAvx2();
+#endif
+
+}  // namespace
+
+void JmerCounter::CountRow(unsigned i, std::vector<Candidate>* row) const {
+#if defined(__x86_64__)
+  unsigned words = index_ ? 0 : signatures_->WordsPerPrimer();
+  if (use_popcnt && words == 1) {
+    CountSignatureRowPopcnt<1>(*rc_signatures_, *signatures_, i, row);
+    return;
+  }
+  if (use_popcnt && words == 4) {
+    CountSignatureRowPopcnt<4>(*rc_signatures_, *signatures_, i, row);
+    return;
+  }
+  if (use_avx2 && words == 16) {
+    CountSignatureRowAvx2<16>(*rc_signatures_, *signatures_, i, row);
+    return;
+  }
+  if (use_avx2 && words == 64) {
+    CountSignatureRowAvx2<64>(*rc_signatures_, *signatures_, i, row);
+    return;
+  }
+#endif
+  auto after = std::lower_bound(row->begin(), row->end(), i,
+      [](const Candidate &candidate, unsigned partner) {
+        return candidate.partner < partner;
+      });
+  if (!index_ || after == row->end()) {
+    for (Candidate &candidate : *row) {
+      candidate.jmers = Count(i, candidate.partner);
+    }
+    return;
+  }
+  // the partners before i are scored from their own reverse complements
+  for (auto candidate = row->begin(); candidate != after; ++candidate) {
+    candidate->jmers = Count(i, candidate->partner);
+  }
+  // every hit in the range of the rest, sorted, is a run of each partner as
+  // long as its count
+  std::vector<unsigned> hits;
+  index_->CountShared(i, after->partner, row->back().partner + 1, &hits);
+  std::sort(hits.begin(), hits.end());
+  auto hit = hits.begin();
+  for (auto candidate = after; candidate != row->end(); ++candidate) {
+    while (hit != hits.end() && *hit < candidate->partner) ++hit;
+    auto run = hit;
+    while (hit != hits.end() && *hit == candidate->partner) ++hit;
+    candidate->jmers = hit - run;
+  }
+}
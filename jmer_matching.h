@@ -0,0 +1,133 @@
+#ifndef JMER_MATCHING_H
+#define JMER_MATCHING_H
+
+#include <stdint.h>     // for uint64_t
+
+#include <memory>       // for std::unique_ptr
+#include <utility>      // for std::swap
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "kmer.h"
+#include "mapped_array.h"
+#include "primer_panel.h"
+
+class IndexReader;
+class IndexWriter;
+
+// One 4^j-bit signature per primer, with bit p set if the j-mer with code p
+// occurs in the primer (or in its reverse complement if rc is true). This is
+// the transpose of a jmer x primer table: all the j-mers of a primer are in
+// one contiguous run of words, so comparing two primers touches two short
+// arrays instead of striding through 4^j rows.
+class JmerSignatures {
+ public:
+  JmerSignatures(const PrimerPanel &primers, unsigned j, bool rc, bool coarse);
+  // signatures saved by Save, viewing the reader's mapping
+  explicit JmerSignatures(IndexReader* reader);
+  void Save(IndexWriter* writer) const;
+
+  unsigned size() const {
+    return number_of_primers_;
+  }
+  unsigned WordsPerPrimer() const {
+    return words_per_primer_;
+  }
+  const uint64_t* Signature(unsigned i) const {
+    return &words_[static_cast<size_t>(i) * words_per_primer_];
+  }
+
+ private:
+  unsigned number_of_primers_;
+  unsigned words_per_primer_;
+  MappedArray<uint64_t> words_;
+};
+
+// popcount(a & b) over n words, using AVX2 when the cpu has it
+unsigned PopcountAnd(const uint64_t* a, const uint64_t* b, unsigned n);
+
+// the number of distinct j-mers shared by signature i of rc_signatures and
+// signature k of signatures
+inline unsigned SharedJmers(const JmerSignatures &rc_signatures, unsigned i,
+    const JmerSignatures &signatures, unsigned k) {
+  return PopcountAnd(rc_signatures.Signature(i), signatures.Signature(k),
+      signatures.WordsPerPrimer());
+}
+
+// A sparse inverted index of j-mers for j too large for JmerSignatures (any
+// j up to max_kmer_len). Only j-mers which actually occur are stored: the
+// distinct forward j-mers of all primers as sorted codes, each with a
+// posting list of the primers containing it, and for every primer the
+// posting lists hit by the distinct j-mers of its reverse complement.
+class JmerIndex {
+ public:
+  JmerIndex(const PrimerPanel &primers, unsigned j, bool coarse);
+  // an index saved by Save, viewing the reader's mapping
+  explicit JmerIndex(IndexReader* reader);
+  void Save(IndexWriter* writer) const;
+
+  unsigned size() const {
+    return rc_offsets_.size() - 1;
+  }
+  // Appends to partners every primer k in [first, last) sharing a j-mer
+  // with rc(primer i), once for each distinct j-mer shared, so that the
+  // times k appears is SharedJmers(i, k). The work done is proportional to
+  // the number of (j-mer, primer) hits in the range, not to size() or 4^j.
+  void CountShared(unsigned i, unsigned first, unsigned last,
+      std::vector<unsigned>* partners) const;
+  // the number of distinct j-mers shared by rc(primer i) and primer k
+  unsigned SharedJmers(unsigned i, unsigned k) const;
+  // the (j-mer, primer) entries of the posting lists and rc lists
+  size_t Entries() const {
+    return postings_.size() + rc_lists_.size();
+  }
+
+ private:
+  MappedArray<unsigned> primer_offsets_;
+  MappedArray<kmer_t> primer_codes_;
+  MappedArray<kmer_t> codes_;
+  MappedArray<unsigned> posting_offsets_;
+  MappedArray<unsigned> postings_;
+  MappedArray<unsigned> rc_offsets_;
+  MappedArray<unsigned> rc_lists_;
+};
+
+// signatures take 4^j bits per primer, so for j above this JmerCounter uses
+// JmerIndex instead
+const unsigned max_signature_j = 6;
+
+// Shared j-mer counts of single pairs, from JmerSignatures when j is at most
+// max_signature_j and from a JmerIndex otherwise.
+class JmerCounter {
+ public:
+  JmerCounter(const PrimerPanel &primers, unsigned j, bool coarse);
+  // a counter saved by Save, viewing the reader's mapping
+  explicit JmerCounter(IndexReader* reader);
+  void Save(IndexWriter* writer) const;
+
+  // the number of j-mers of rc(primer min(i, k)) which are also in primer
+  // max(i, k)
+  unsigned Count(unsigned i, unsigned k) const {
+    if (k < i) std::swap(i, k);
+    if (index_) return index_->SharedJmers(i, k);
+    return SharedJmers(*rc_signatures_, i, *signatures_, k);
+  }
+  // Sets the jmers of every candidate in row i to Count(i, partner). Each
+  // signature size, j up to max_signature_j, has a kernel with its word
+  // loop unrolled; with an index the partners after i are counted from the
+  // posting lists of rc(primer i) over the range of the row, rather than
+  // by a merge per pair.
+  void CountRow(unsigned i, std::vector<Candidate>* row) const;
+  // the distinct (j-mer, primer) entries of the signatures or index
+  size_t Entries() const;
+  // the bytes Count reads for the larger primer of a pair: its signature,
+  // or on average its codes in the index
+  size_t BytesPerPrimer() const;
+
+ private:
+  std::unique_ptr<JmerSignatures> signatures_;
+  std::unique_ptr<JmerSignatures> rc_signatures_;
+  std::unique_ptr<JmerIndex> index_;
+};
+
+#endif
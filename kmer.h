@@ -0,0 +1,76 @@
+#ifndef KMER_H
+#define KMER_H
+
+#include <stdint.h>     // for uint64_t
+
+#include <string>       // for std::string
+#include <type_traits>  // for std::integral_constant
+
+#include "primer_panel.h"
+
+// A k-mer packed 2 bits per base into a base-4 number, first base most
+// significant, so k can be at most 32.
+typedef uint64_t kmer_t;
+
+const unsigned max_kmer_len = 32;
+
+// A length known at compile time, for kernels whose length argument is a
+// template type: given one in place of an unsigned, the kernel is
+// instantiated with its masks, shifts and loop bounds folded to constants.
+template <unsigned K>
+using FixedLength = std::integral_constant<unsigned, K>;
+
+inline kmer_t KmerMask(unsigned k) {
+  return k >= max_kmer_len ? ~0ull : (1ull << (2 * k)) - 1;
+}
+
+// number of distinct k-mers, i.e. the size of a table indexed by kmer_t
+inline uint64_t KmerCount(unsigned k) {
+  return 1ull << (2 * k);
+}
+
+// the number of bases at which two k-mers differ, given the xor of their codes
+inline unsigned BaseMismatches(kmer_t x) {
+  return __builtin_popcountll((x | (x >> 1)) & 0x5555555555555555ull);
+}
+
+inline kmer_t KmerCode(const std::string &str) {
+  kmer_t code = 0;
+  for (char c : str) code = (code << 2) | (EncodeBase(c) & 3);
+  return code;
+}
+
+// Calls visit(start, code, rc_code) for every window [start, start + k) of
+// primer i in increasing order of start, where code is the packed window and
+// rc_code is the packed reverse complement of the window. Both codes are
+// rolled forward with shifts and masks in a single pass over the planes, so
+// no window is ever copied or rehashed. The reverse complement of window
+// start is the window len - k - start of the reverse complemented primer.
+// k is an unsigned or a FixedLength.
+template <typename Length, typename Visitor>
+void ForEachKmer(const PrimerPanel &primers, unsigned i, Length k,
+    Visitor visit) {
+  unsigned len = primers.Length(i);
+  if (k == 0 || k > len || k > max_kmer_len) return;
+  const uint64_t* planes = primers.Planes(i);
+  const kmer_t mask = KmerMask(k);
+  const unsigned rc_shift = 2 * (k - 1);
+  kmer_t code = 0;
+  kmer_t rc_code = 0;
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+  for (unsigned pos = 0; pos < len; ++pos) {
+    if (pos % 64 == 0) {
+      lo = planes[2 * (pos / 64)];
+      hi = planes[2 * (pos / 64) + 1];
+    }
+    kmer_t base = (lo & 1) | ((hi & 1) << 1);
+    lo >>= 1;
+    hi >>= 1;
+    code = ((code << 2) | base) & mask;
+    rc_code = (rc_code >> 2) | ((base ^ 1) << rc_shift);
+    if (pos + 1 >= k) visit(pos + 1 - k, code, rc_code);
+  }
+}
+
+#endif
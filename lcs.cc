@@ -0,0 +1,130 @@
+#include "lcs.h"
+
+#include <stdint.h>     // for uint64_t, uint8_t
+
+#if defined(__x86_64__)
+#include <immintrin.h>  // for AVX2 intrinsics
+#endif
+
+namespace {
+
+unsigned LcsLenPacked(const uint64_t* a, unsigned len_a, const uint64_t* b,
+    unsigned len_b) {
+  // bit p of a match mask is set when base p + shift of one sequence equals
+  // base p of the other, so every run of set bits is a common substring
+  const uint64_t a_lo = a[0], a_hi = a[1], b_lo = b[0], b_hi = b[1];
+  const uint64_t valid_a = LowMask(len_a), valid_b = LowMask(len_b);
+  unsigned lcs_len = 0;
+  for (unsigned shift = 0; shift < len_a && len_a - shift > lcs_len; ++shift) {
+    uint64_t matches = ~(((a_lo >> shift) ^ b_lo) | ((a_hi >> shift) ^ b_hi)) &
+        (valid_a >> shift) & valid_b;
+    UpdateLongestRun(matches, &lcs_len);
+  }
+  for (unsigned shift = 1; shift < len_b && len_b - shift > lcs_len; ++shift) {
+    uint64_t matches = ~((a_lo ^ (b_lo >> shift)) | (a_hi ^ (b_hi >> shift))) &
+        valid_a & (valid_b >> shift);
+    UpdateLongestRun(matches, &lcs_len);
+  }
+  return lcs_len;
+}
+
+unsigned LcsLenScan(const PrimerPanel &primers, unsigned i, unsigned j) {
+  // walk every diagonal of the dp table keeping only the current run
+  unsigned len1 = primers.Length(i);
+  unsigned len2 = primers.Length(j);
+  unsigned lcs_len = 0;
+  for (unsigned diagonal = 1; diagonal < len1 + len2; ++diagonal) {
+    unsigned col = diagonal < len2 ? 0 : diagonal - len2;
+    unsigned row = diagonal < len2 ? len2 - diagonal : 0;
+    unsigned run = 0;
+    for (; col < len1 && row < len2; ++col, ++row) {
+      if (primers.RcBase(i, col) == primers.Base(j, row)) {
+        if (++run > lcs_len) lcs_len = run;
+      } else {
+        run = 0;
+      }
+    }
+  }
+  return lcs_len;
+}
+
+#if defined(__x86_64__)
+// the byte lanes count run lengths, so sequences must be shorter than 256
+const unsigned max_batch_len = 255;
+
+// scores one block of at most lcs_batch_lanes targets
+__attribute__((target("avx2")))
+void LcsLenBlockAvx2(const PrimerPanel &primers, unsigned query,
+    const unsigned* targets, unsigned count, unsigned* lcs_lens) {
+  // targets transposed base by base, padded with a code no query base has
+  alignas(32) uint8_t columns[max_batch_len][lcs_batch_lanes];
+  unsigned rows = 0;
+  for (unsigned t = 0; t < count; ++t) {
+    if (primers.Length(targets[t]) > rows) rows = primers.Length(targets[t]);
+  }
+  for (unsigned row = 0; row < rows; ++row) {
+    for (unsigned t = 0; t < lcs_batch_lanes; ++t) {
+      columns[row][t] = t < count && row < primers.Length(targets[t]) ?
+          primers.Base(targets[t], row) : 0xff;
+    }
+  }
+
+  // run[col] holds, for every lane, the length of the common substring
+  // ending at base col - 1 of the query and the previous base of the target
+  unsigned cols = primers.Length(query);
+  uint8_t query_bases[max_batch_len];
+  for (unsigned col = 0; col < cols; ++col) {
+    query_bases[col] = primers.RcBase(query, col);
+  }
+  __m256i run[max_batch_len + 1];
+  for (unsigned col = 0; col <= cols; ++col) run[col] = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  __m256i best = _mm256_setzero_si256();
+  for (unsigned row = 0; row < rows; ++row) {
+    const __m256i target_bases =
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(columns[row]));
+    for (unsigned col = cols; col > 0; --col) {
+      __m256i match = _mm256_cmpeq_epi8(target_bases,
+          _mm256_set1_epi8(query_bases[col - 1]));
+      run[col] = _mm256_and_si256(match, _mm256_add_epi8(run[col - 1], one));
+      best = _mm256_max_epu8(best, run[col]);
+    }
+  }
+  alignas(32) uint8_t lane_best[lcs_batch_lanes];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lane_best), best);
+  for (unsigned t = 0; t < count; ++t) lcs_lens[t] = lane_best[t];
+}
+
+bool UseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+const bool use_avx2 = UseAvx2();
+#endif
+
+}  // namespace
+
+void LcsLenBatch(const PrimerPanel &primers, unsigned query,
+    const unsigned* targets, unsigned count, unsigned* lcs_lens) {
+#if defined(__x86_64__)
+  if (use_avx2 && primers.MaxLength() <= max_batch_len) {
+    for (unsigned t = 0; t < count; t += lcs_batch_lanes) {
+      unsigned block = count - t < lcs_batch_lanes ? count - t : lcs_batch_lanes;
+      LcsLenBlockAvx2(primers, query, targets + t, block, lcs_lens + t);
+    }
+    return;
+  }
+#endif
+  for (unsigned t = 0; t < count; ++t) {
+    lcs_lens[t] = LcsLen(primers, query, targets[t]);
+  }
+}
+
+unsigned LcsLen(const PrimerPanel &primers, unsigned i, unsigned j) {
+  if (primers.Length(i) <= 64 && primers.Length(j) <= 64) {
+    return LcsLenPacked(primers.RcPlanes(i), primers.Length(i),
+        primers.Planes(j), primers.Length(j));
+  }
+  return LcsLenScan(primers, i, j);
+}
@@ -0,0 +1,51 @@
+#ifndef LCS_H
+#define LCS_H
+
+#include <stdint.h>     // for uint64_t
+
+#include "primer_panel.h"
+
+// the low len bits
+inline uint64_t LowMask(unsigned len) {
+  return len >= 64 ? ~0ull : (1ull << len) - 1;
+}
+
+// returns the positions in x which start a run of at least len set bits
+inline uint64_t RunsOfAtLeast(uint64_t x, unsigned len) {
+  unsigned have = 1;
+  while (have < len && x) {
+    unsigned shift = have < len - have ? have : len - have;
+    x &= x >> shift;
+    have += shift;
+  }
+  return x;
+}
+
+// raises lcs_len to the longest run of set bits in matches
+inline void UpdateLongestRun(uint64_t matches, unsigned* lcs_len) {
+  uint64_t runs = RunsOfAtLeast(matches, *lcs_len + 1);
+  while (runs) {
+    ++*lcs_len;
+    runs &= runs >> 1;
+  }
+}
+
+// Length of the longest common substring of rc(primer i) and primer j.
+// Primers of up to 64 bases are compared one diagonal at a time with
+// bit-parallel run tracking on their packed planes; longer primers fall
+// back to a base-by-base scan of the diagonals. Neither path allocates.
+unsigned LcsLen(const PrimerPanel &primers, unsigned i, unsigned j);
+
+// the number of targets scored together by LcsLenBatch
+const unsigned lcs_batch_lanes = 32;
+
+// Sets lcs_lens[t] = LcsLen(primers, query, targets[t]) for t < count.
+// Targets are scored in blocks of lcs_batch_lanes, one target per byte lane
+// of an AVX2 register: the targets of a block are transposed base by base so
+// that each step of the dp recurrence advances all of them against the same
+// base of rc(primer query). Without AVX2, or for primers longer than 255
+// bases, each pair is scored with LcsLen.
+void LcsLenBatch(const PrimerPanel &primers, unsigned query,
+    const unsigned* targets, unsigned count, unsigned* lcs_lens);
+
+#endif
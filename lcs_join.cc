@@ -0,0 +1,204 @@
+#include "lcs_join.h"
+
+#include <stdint.h>     // for uint64_t
+
+#include <algorithm>    // for std::sort, std::min
+#include <utility>      // for std::pair
+
+#include "kmer.h"
+
+namespace {
+
+// ends every primer of the text, sorting after every base code
+const uint8_t separator = 4;
+// the symbols of a suffix folded into its sort key, base 5 so that the
+// separator takes part
+const unsigned key_symbols = 27;
+
+}  // namespace
+
+LcsJoin::LcsJoin(const PrimerPanel &primers, unsigned min_lcs,
+    LcsFilter filter)
+    : primers_(primers), min_lcs_(min_lcs) {
+  if (filter == kJoinLcsFilter && min_lcs >= 1 && min_lcs <= max_kmer_len) {
+    index_.reset(new JmerIndex(primers, min_lcs, false));
+    return;
+  }
+
+  size_t total = 0;
+  for (unsigned k = 0; k < primers.size(); ++k) total += primers.Length(k) + 1;
+  text_.reserve(total);
+  owners_.reserve(total);
+  for (unsigned k = 0; k < primers.size(); ++k) {
+    for (unsigned p = 0; p < primers.Length(k); ++p) {
+      text_.push_back(primers.Base(k, p));
+      owners_.push_back(k);
+    }
+    text_.push_back(separator);
+    owners_.push_back(k);
+  }
+
+  // Sort the suffixes by their first key_symbols symbols, reading past a
+  // separator as more separators, and break the few ties that are left
+  // with a full comparison. Equal suffixes keep the order of the text.
+  struct Suffix {
+    uint64_t key;
+    unsigned pos;
+  };
+  std::vector<Suffix> sorted;
+  sorted.reserve(total - primers.size());
+  for (unsigned pos = 0; pos < text_.size(); ++pos) {
+    if (text_[pos] == separator) continue;
+    uint64_t key = 0;
+    bool ended = false;
+    for (unsigned q = 0; q < key_symbols; ++q) {
+      if (!ended && text_[pos + q] == separator) ended = true;
+      key = key * 5 + (ended ? separator : text_[pos + q]);
+    }
+    sorted.push_back({key, pos});
+  }
+  const std::vector<uint8_t> &text = text_;
+  std::sort(sorted.begin(), sorted.end(),
+      [&text](const Suffix &a, const Suffix &b) {
+        if (a.key != b.key) return a.key < b.key;
+        unsigned q = 0;
+        while (q < key_symbols && text[a.pos + q] != separator) ++q;
+        if (q == key_symbols) {
+          while (text[a.pos + q] == text[b.pos + q]
+              && text[a.pos + q] != separator) {
+            ++q;
+          }
+          if (text[a.pos + q] != text[b.pos + q]) {
+            return text[a.pos + q] < text[b.pos + q];
+          }
+        }
+        return a.pos < b.pos;
+      });
+
+  suffixes_.resize(sorted.size());
+  lcps_.assign(sorted.size(), 0);
+  for (size_t s = 0; s < sorted.size(); ++s) {
+    suffixes_[s] = sorted[s].pos;
+    if (s == 0) continue;
+    unsigned a = suffixes_[s - 1];
+    unsigned b = suffixes_[s];
+    unsigned lcp = 0;
+    while (text_[a + lcp] == text_[b + lcp] && text_[a + lcp] != separator) {
+      ++lcp;
+    }
+    lcps_[s] = lcp;
+  }
+}
+
+void LcsJoin::Row(unsigned i, unsigned first, unsigned last,
+    std::vector<Candidate>* row) const {
+  if (index_) {
+    JoinRow(i, first, last, row);
+  } else {
+    SuffixArrayRow(i, first, last, row);
+  }
+}
+
+void LcsJoin::JoinRow(unsigned i, unsigned first, unsigned last,
+    std::vector<Candidate>* row) const {
+  // A primer appears once for every t-mer it shares, so mark the partners
+  // in a bitmap kept by the thread, noting each word as it is first set.
+  // Reading back only the words noted, in order, lists every partner once
+  // in time following the postings read, and leaves the bitmap clear.
+  thread_local std::vector<uint64_t> bitmap_buffer;
+  thread_local std::vector<unsigned> partner_buffer;
+  thread_local std::vector<unsigned> word_buffer;
+  std::vector<uint64_t> &marked = bitmap_buffer;
+  std::vector<unsigned> &partners = partner_buffer;
+  std::vector<unsigned> &words = word_buffer;
+  if (marked.size() < (primers_.size() + 63) / 64) {
+    marked.resize((primers_.size() + 63) / 64, 0);
+  }
+  partners.clear();
+  index_->CountShared(i, first, last, &partners);
+  words.clear();
+  for (unsigned k : partners) {
+    if (marked[k / 64] == 0) words.push_back(k / 64);
+    marked[k / 64] |= (uint64_t)1 << (k % 64);
+  }
+  std::sort(words.begin(), words.end());
+  row->clear();
+  for (unsigned w : words) {
+    for (uint64_t bits = marked[w]; bits; bits &= bits - 1) {
+      row->push_back({64 * w + __builtin_ctzll(bits), 0, 0});
+    }
+    marked[w] = 0;
+  }
+}
+
+unsigned LcsJoin::CommonPrefix(const uint8_t* query, unsigned len,
+    unsigned pos) const {
+  // the query holds no separator, so the text ends the comparison in time
+  unsigned q = 0;
+  while (q < len && query[q] == text_[pos + q]) ++q;
+  return q;
+}
+
+void LcsJoin::SuffixArrayRow(unsigned i, unsigned first, unsigned last,
+    std::vector<Candidate>* row) const {
+  row->clear();
+  unsigned len = primers_.Length(i);
+  if (min_lcs_ == 0 || len < min_lcs_) return;
+  std::vector<uint8_t> rc(len);
+  for (unsigned p = 0; p < len; ++p) rc[p] = primers_.RcBase(i, p);
+
+  // (partner, length) for every suffix agreeing with a suffix of rc on at
+  // least min_lcs bases
+  std::vector<std::pair<unsigned, unsigned>> matches;
+  for (unsigned p = 0; p + min_lcs_ <= len; ++p) {
+    const uint8_t* query = rc.data() + p;
+    unsigned query_len = len - p;
+    // the first suffix not below the query, separators sorting last
+    size_t lower = 0;
+    size_t count = suffixes_.size();
+    while (count > 0) {
+      size_t step = count / 2;
+      unsigned pos = suffixes_[lower + step];
+      unsigned q = CommonPrefix(query, query_len, pos);
+      if (q < query_len && text_[pos + q] < query[q]) {
+        lower += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+    // the suffixes on either side share the most with the query, and the
+    // agreement can only shrink, by the lcps between them, further out
+    if (lower > 0) {
+      size_t s = lower - 1;
+      unsigned lcp = CommonPrefix(query, query_len, suffixes_[s]);
+      while (lcp >= min_lcs_) {
+        unsigned k = owners_[suffixes_[s]];
+        if (k >= first && k < last) matches.push_back(std::make_pair(k, lcp));
+        if (s == 0) break;
+        lcp = std::min(lcp, lcps_[s]);
+        --s;
+      }
+    }
+    if (lower < suffixes_.size()) {
+      size_t s = lower;
+      unsigned lcp = CommonPrefix(query, query_len, suffixes_[s]);
+      while (lcp >= min_lcs_) {
+        unsigned k = owners_[suffixes_[s]];
+        if (k >= first && k < last) matches.push_back(std::make_pair(k, lcp));
+        if (++s == suffixes_.size()) break;
+        lcp = std::min(lcp, lcps_[s]);
+      }
+    }
+  }
+
+  // the LCS of a pair is its longest agreement from any suffix of rc
+  std::sort(matches.begin(), matches.end());
+  for (size_t m = 0; m < matches.size(); ++m) {
+    if (m + 1 < matches.size() && matches[m + 1].first == matches[m].first) {
+      continue;
+    }
+    row->push_back({matches[m].first, 0,
+        static_cast<uint16_t>(matches[m].second)});
+  }
+}
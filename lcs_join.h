@@ -0,0 +1,69 @@
+#ifndef LCS_JOIN_H
+#define LCS_JOIN_H
+
+#include <stdint.h>     // for uint8_t
+
+#include <memory>       // for std::unique_ptr
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "jmer_matching.h"
+#include "primer_panel.h"
+
+// How the minimum_lcs_threshold is tested: by the dp of LcsLenBatch on
+// every pair that reaches it, by a join of shared t-mers, or by a suffix
+// array which also gives the true LCS of the pairs that pass.
+enum LcsFilter { kDpLcsFilter, kJoinLcsFilter, kSuffixArrayLcsFilter };
+
+// Lists the pairs whose longest common substring is at least min_lcs
+// bases, a row at a time, without scoring any pair that fails: rc(primer
+// i) and primer k have a common substring of min_lcs bases exactly when
+// they share a min_lcs-mer. The work for a row follows the number of
+// shared t-mers in its range of partners, not the size of the panel.
+//
+// The join keeps a JmerIndex of the min_lcs-mers of every primer and
+// collects the posting lists of those of rc(primer i). The suffix array
+// holds every suffix of every primer instead: each suffix of rc(primer i)
+// is looked up once, and the suffixes agreeing with it on min_lcs bases
+// or more sit around that spot, with the length of each agreement read
+// from the lcp array, so every pair passing gets its exact LCS. Thresholds
+// above max_kmer_len always use the suffix array.
+class LcsJoin {
+ public:
+  LcsJoin(const PrimerPanel &primers, unsigned min_lcs, LcsFilter filter);
+
+  unsigned MinLcs() const {
+    return min_lcs_;
+  }
+  // whether rows carry the lcs_len of each pair rather than 0
+  bool ExactLengths() const {
+    return index_ == nullptr;
+  }
+  // Sets row to every primer k in [first, last) with LcsLen(primers, i, k)
+  // >= MinLcs(), in increasing order of partner; last may be past the
+  // panel.
+  void Row(unsigned i, unsigned first, unsigned last,
+      std::vector<Candidate>* row) const;
+
+ private:
+  void JoinRow(unsigned i, unsigned first, unsigned last,
+      std::vector<Candidate>* row) const;
+  void SuffixArrayRow(unsigned i, unsigned first, unsigned last,
+      std::vector<Candidate>* row) const;
+  // the number of leading bases query[0, len) shares with the text from pos
+  unsigned CommonPrefix(const uint8_t* query, unsigned len, unsigned pos) const;
+
+  const PrimerPanel &primers_;
+  unsigned min_lcs_;
+  std::unique_ptr<JmerIndex> index_;
+  // the codes of every primer, each followed by a separator; the suffixes
+  // starting at bases in sorted order; lcps_[s] the bases suffix s shares
+  // with suffix s - 1, stopping at a separator; owners_ the primer of each
+  // position of the text
+  std::vector<uint8_t> text_;
+  std::vector<unsigned> suffixes_;
+  std::vector<unsigned> lcps_;
+  std::vector<unsigned> owners_;
+};
+
+#endif
@@ -1,77 +1,68 @@
-#include <math.h>       // for pow()
-#include <stdio.h>      // for printf, scanf, fgets
-#include <stdlib.h>     // for malloc()
+#include <stdio.h>      // for fopen(), fclose()
+#include <stdlib.h>     // for exit()
 
-#include <algorithm>    // for std::accumulate()
-#include <fstream>      // for std::ifstream
+#include <algorithm>    // for std::min
+#include <chrono>       // for std::chrono::steady_clock
+#include <fstream>      // for std::ofstream
 #include <iostream>     // for std::cout
-#include <limits>       // for std::numeric_limits
-#include <map>          // for std::map
-#include <set>          // for std::set
+#include <memory>       // for std::unique_ptr
+#include <string>       // for std::string
+#include <unordered_set>  // for std::unordered_set
+#include <vector>       // for std::vector
 
-const unsigned tail_len = 5;
-const unsigned max_mismatches = 1;
-const unsigned j = 5;
-const unsigned minimum_matching_jmers = 3;
-const unsigned minimum_lcs_threshold = 6;
-const bool coarse = false;  // if this is true, one primer of each pair will be parsed end-to-end
+#include "candidate_pairs.h"
+#include "incremental_screen.h"
+#include "jmer_matching.h"
+#include "lcs.h"
+#include "lcs_join.h"
+#include "metrics.h"
+#include "options.h"
+#include "panel_file.h"
+#include "panel_index.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "primer_panel.h"
+#include "ranking.h"
+#include "result_writer.h"
+#include "tail_matching.h"
 
-const unsigned number_of_bases = 4;
-
-class PrimerClass {
-  std::string name_;
-  std::string sequence_;
- public:
-  void SetName(std::string str) {
-    name_ = str;
-  }
-  void SetSequence(std::string str) {
-    sequence_ = str;
-  }
-  void Print() {
-    std::cout << "name: " << name_ << '\n';
-    std::cout << "sequence: " << sequence_ << '\n';
-  }
-  std::string GetName() {
-    return name_;
-  }
-  std::string GetSequence() {
-    return sequence_;
-  }
-};
-
-typedef struct node {
-  int primer_index;
-  node* next;
-} node_t;
-
-std::vector<char> bases = {'A', 'T', 'C', 'G'};
-std::map<char, char> complement_map = {{'A', 'T'}, {'T', 'A'}, {'C', 'G'}, {'G', 'C'}};
-std::map<char, char> next_base = {{'A', 'T'}, {'T', 'C'}, {'C', 'G'}, {'G', 'A'}};
-std::map<char, int> base_map = {{'A', 0}, {'T', 1}, {'C', 2}, {'G', 3}};
-
-int hash(const std::string &str);
-std::string ReverseComplement(const std::string &src);
-bool ValidSequence(std::string str);
-std::vector<PrimerClass> ReadInputFile(const std::string &input_file_name);
-std::set<std::set<int>> kSubsets(int n, int k);
-std::set<std::string> kMismatch(std::string input_str, int max_mismatches);
-std::vector<node_t*> LoadTailTable(std::vector<PrimerClass> primers, int tail_len,
-    int max_mismatches);
-std::vector<std::vector<bool>> MatchTails(std::vector<PrimerClass> primers,
-    int tail_len, int max_mismatches);
-std::vector<std::vector<bool>> LoadJmerTable(std::vector<PrimerClass> primers,
-    unsigned j, bool rc, bool coarse);
-std::vector<std::vector<unsigned>> MatchJmers(std::vector<PrimerClass> primers,
-    int j, bool coarse);
-unsigned LcsLen(std::string str1, std::string str2);
+PrimerPanel ReadInputFile(const std::string &input_file_name);
+std::unordered_set<std::string> ReadNames(const std::string &file_name);
+unsigned long long NumberOfWindows(const PrimerPanel &primers, unsigned k);
 
 int main(int argc, char* argv[]) {
-  if (argc < 2) {
-    std::cout << "please supply one input argument, the input file path\n";
+  Options options;
+  std::string error;
+  if (!ParseOptions(argc, argv, &options, &error)) {
+    std::cout << error << "\n\n";
+    PrintUsage(std::cout);
+    std::exit(EXIT_FAILURE);
+  }
+  if (options.help) {
+    PrintUsage(std::cout);
+    std::exit(EXIT_SUCCESS);
   }
-  std::string input_file_name;
-  input_file_name = argv[1];
+  const std::string &input_file_name = options.input_file_name;
+  const std::string &append_file_name = options.append_file_name;
+  const std::string &remove_file_name = options.remove_file_name;
+  const std::string &index_file_name = options.index_file_name;
+  const unsigned tail_len = options.tail_len;
+  const unsigned max_mismatches = options.max_mismatches;
+  const unsigned j = options.j;
+  const unsigned minimum_matching_jmers = options.minimum_matching_jmers;
+  const unsigned minimum_lcs_threshold = options.minimum_lcs_threshold;
+  const bool coarse = options.coarse;
+  const unsigned threads = options.threads;
+  const TailIndex tail_index = options.tail_index;
+  Metrics metrics;
+  metrics.Value("input_file_name", input_file_name);
+  metrics.Value("tail_len", tail_len);
+  metrics.Value("max_mismatches", max_mismatches);
+  metrics.Value("j", j);
+  metrics.Value("minimum_matching_jmers", minimum_matching_jmers);
+  metrics.Value("minimum_lcs_threshold", minimum_lcs_threshold);
+  metrics.Value("coarse", coarse);
+  metrics.Value("threads", ResolveThreads(threads));
 
   // print parameters
   std::cout << "========================================\n";
@@ -84,44 +75,181 @@ int main(int argc, char* argv[]) {
   std::cout << "minimum_matching_jmers = " << minimum_matching_jmers << '\n';
   std::cout << "minimum_lcs_threshold = " << minimum_lcs_threshold << '\n';
   std::cout << "coarse = " << coarse << '\n';
+  std::cout << "threads = " << threads << '\n';
   std::cout << "========================================\n";
   std::cout << '\n';
 
-  // load primers
-  auto primers = ReadInputFile(input_file_name);
+  // load primers, mapping them from an index file if given one
+  PanelIndex index;
+  PrimerPanel read_primers;
+  if (IsIndexFile(input_file_name)) {
+    metrics.BeginStage("open index");
+    if (!index.Open(input_file_name, &error)) {
+      std::cout << error << '\n';
+      std::exit(EXIT_FAILURE);
+    }
+  } else {
+    metrics.BeginStage("read panel");
+    read_primers = ReadInputFile(input_file_name);
+  }
+  const PrimerPanel &primers = index.IsOpen() ? index.Primers() : read_primers;
+  metrics.EndStage();
+  metrics.Count("primers", primers.size());
+  metrics.Count("bases", NumberOfWindows(primers, 1));
 
-  // calculate tail and jmer hits
-  auto tail_hits = MatchTails(primers, tail_len, max_mismatches);
-  auto jmer_hits = MatchJmers(primers, j, coarse);
+  // use the tables of the index unless it was built with other parameters
+  std::unique_ptr<TailMatcher> built_matcher;
+  std::unique_ptr<JmerCounter> built_counter;
+  bool use_index = index.IsOpen()
+      && index.BuiltWith(tail_len, max_mismatches, tail_index, j, coarse);
+  if (!use_index) {
+    metrics.BeginStage("tail index");
+    built_matcher.reset(
+        new TailMatcher(primers, tail_len, max_mismatches, tail_index));
+    metrics.EndStage();
+    metrics.Count("tails_hashed", primers.size());
+    metrics.Count("table_entries", built_matcher->TableEntries());
+    metrics.BeginStage("jmer index");
+    built_counter.reset(new JmerCounter(primers, j, coarse));
+    metrics.EndStage();
+    metrics.Count("windows_hashed", NumberOfWindows(primers, j));
+    metrics.Count("table_entries", built_counter->Entries());
+  }
+  const TailMatcher &tail_matcher = use_index ? index.Matcher() : *built_matcher;
+  const JmerCounter &jmer_counter = use_index ? index.Counter() : *built_counter;
+  if (!index_file_name.empty()) {
+    metrics.BeginStage("write index");
+    if (!WritePanelIndex(index_file_name, primers, tail_matcher, tail_index,
+        jmer_counter, j, coarse)) {
+      std::cout << "Could not write index file.\n";
+      std::exit(EXIT_FAILURE);
+    }
+    metrics.EndStage();
+  }
 
-  // print statistics
+  // filter the pairs, cheapest test first
+  metrics.BeginStage("tail match");
+  auto tail_hits = MatchTails(primers, tail_matcher, threads, true);
+  metrics.EndStage();
+  metrics.Count("windows_scanned", NumberOfWindows(primers, tail_len));
+  metrics.Count("pairs_found", tail_hits.size());
+  // the lcs threshold is met by the pairs sharing a t-mer, which a join
+  // lists directly
+  std::unique_ptr<LcsJoin> lcs_join;
+  if (minimum_lcs_threshold > 0 && options.lcs_filter != kDpLcsFilter) {
+    metrics.BeginStage("lcs index");
+    lcs_join.reset(
+        new LcsJoin(primers, minimum_lcs_threshold, options.lcs_filter));
+    metrics.EndStage();
+  }
+  // an output file is written as the rows pass the filters, from the
+  // writer's thread, unless the incremental screen changes them first;
+  // stdout waits for the report
+  bool screened = !append_file_name.empty() || !remove_file_name.empty();
+  FILE* output_file = stdout;
+  std::unique_ptr<ResultWriter> writer;
+  if (!options.output_file_name.empty()) {
+    output_file = fopen(options.output_file_name.c_str(),
+        options.output_format == kBinaryOutput ? "wb" : "w");
+    if (output_file == NULL) {
+      std::cout << "Could not open output file.\n";
+      std::exit(EXIT_FAILURE);
+    }
+    writer.reset(new ResultWriter(output_file, options.output_format));
+  }
+  bool stream = output_file != stdout && !screened;
+  metrics.BeginStage("filter");
+  FilterPipeline pipeline(primers.size());
+  pipeline.AddStage(std::unique_ptr<PairStage>(new TailStage(tail_hits)));
+  pipeline.AddStage(std::unique_ptr<PairStage>(
+      new JmerStage(jmer_counter, minimum_matching_jmers)));
+  if (lcs_join) {
+    pipeline.AddStage(std::unique_ptr<PairStage>(new LcsJoinStage(*lcs_join)));
+  } else if (minimum_lcs_threshold > 0) {
+    pipeline.AddStage(std::unique_ptr<PairStage>(
+        new LcsStage(primers, minimum_lcs_threshold)));
+  }
+  // the tsv and binary formats give the lcs of each pair, which the join
+  // only tests the threshold of, so it is scored on the pairs left
+  if (options.output_format != kTextOutput && (minimum_lcs_threshold == 0
+      || (lcs_join && !lcs_join->ExactLengths()))) {
+    pipeline.AddStage(std::unique_ptr<PairStage>(new LcsStage(primers, 0)));
+  }
+  // ranking keeps only the top partners of each primer as the pairs pass,
+  // and counts the candidates in the sample on the way
   unsigned sample_size = std::min(1000u, static_cast<unsigned>(primers.size()));
-  unsigned tail_count = 0;
-  unsigned jmer_count = 0;
-  unsigned lcs_count = 0;
   unsigned all_count = 0;
-  unsigned conditions_met;
-  for (unsigned i = 0; i < sample_size; ++i) {
-    for (unsigned j = 0; j < sample_size; ++j) {
-      conditions_met = 0;
-      if (tail_hits[i][j]) {
-        ++tail_count;
-        ++conditions_met;
+  unsigned long long pairs = 0;
+  CandidatePairs candidates;
+  std::unique_ptr<PairRanking> ranking;
+  if (options.top > 0) {
+    ranking.reset(new PairRanking(primers, tail_len, max_mismatches, j, coarse,
+        options.rank_by, options.top, ResolveThreads(threads)));
+    std::vector<unsigned> sample_counts(ResolveThreads(threads), 0);
+    pipeline.Visit([&](unsigned i, const std::vector<Candidate> &row,
+        unsigned t) {
+      ranking->Add(i, row, t);
+      if (i >= sample_size) return;
+      for (const Candidate &candidate : row) {
+        if (candidate.partner < sample_size) {
+          sample_counts[t] += candidate.partner == i ? 1 : 2;
+        }
       }
-      if (jmer_hits[i][j] >= minimum_matching_jmers) {
-        ++jmer_count;
-        ++conditions_met;
+    }, threads);
+    ranking->Finish();
+    for (unsigned count : sample_counts) all_count += count;
+    pairs = ranking->Pairs();
+  } else {
+    // The rows come in order, each with its partners k >= i; the partners
+    // k < i are mirrored from the earlier rows and kept until row k comes.
+    // The candidates are only held for stdout and the incremental screen.
+    bool keep = !stream;
+    std::vector<std::vector<Candidate>> lower(primers.size());
+    pipeline.VisitRows([&](unsigned i, const Candidate* first,
+        const Candidate* last) {
+      std::vector<Candidate> row;
+      row.swap(lower[i]);
+      row.insert(row.end(), first, last);
+      for (const Candidate* candidate = first; candidate != last;
+          ++candidate) {
+        if (candidate->partner == i) continue;
+        Candidate mirrored = *candidate;
+        mirrored.partner = i;
+        lower[candidate->partner].push_back(mirrored);
       }
-      if (minimum_lcs_threshold == 0 ||
-          LcsLen(ReverseComplement(primers[i].GetSequence()), primers[j].GetSequence()) >= minimum_lcs_threshold) {
-        ++lcs_count;
-        ++conditions_met;
+      pairs += row.size();
+      if (i < sample_size) {
+        for (const Candidate &candidate : row) {
+          if (candidate.partner < sample_size) ++all_count;
+        }
       }
-      if (conditions_met == 3) {
-        ++all_count;
+      if (stream) {
+        writer->WriteRow(primers, i, row.data(), row.data() + row.size());
+      }
+      if (keep) candidates.AppendRow(row);
+    }, threads);
+  }
+  metrics.EndStage();
+  pipeline.RecordMetrics(&metrics);
+  metrics.Count("candidates", pairs);
+
+  // print statistics; the pairs meeting all conditions are the candidates
+  metrics.BeginStage("sample");
+  unsigned tail_count = 0;
+  unsigned jmer_count = 0;
+  for (unsigned i = 0; i < sample_size; ++i) {
+    for (unsigned j = 0; j < sample_size; ++j) {
+      if (jmer_counter.Count(i, j) >= minimum_matching_jmers) ++jmer_count;
+    }
+    // the tail hits are the upper triangle, each pair standing for both
+    for (const Candidate &candidate : tail_hits[i]) {
+      if (candidate.partner < sample_size) {
+        tail_count += candidate.partner == i ? 1 : 2;
       }
     }
   }
+  metrics.EndStage();
+  metrics.Count("pairs_counted", sample_size * sample_size);
   std::cout << "========================================\n";
   std::cout << "Results for small sample ===============\n";
   std::cout << "========================================\n";
@@ -132,314 +260,181 @@ int main(int argc, char* argv[]) {
   std::cout << "========================================\n";
   std::cout << "\n";
 
-  // final results
-  std::cout << "========================================\n";
-  std::cout << "Results: primer dimer candidates =======\n";
-  std::cout << "========================================\n";
-  int count = 0;
-  bool found;
-  for (auto i = 0u; i < primers.size(); ++i) {
-    found = false;
-    for (auto j = 0u; j < primers.size(); ++j) {
-      if (!tail_hits[i][j]) continue;
-      if (jmer_hits[i][j] < minimum_matching_jmers) continue;
-      if (minimum_lcs_threshold > 0 && LcsLen(ReverseComplement(primers[i].GetSequence()), primers[j].GetSequence()) < minimum_lcs_threshold) continue;
-      if (!found) {
-        std::cout << '\n' << primers[i].GetName() << " : ";
-        std::cout << primers[j].GetName();
-        found = true;
-      } else {
-        std::cout << ", " << primers[j].GetName();
-      }
-      ++count;
-      //if (count % 100 == 0) std::cout << "count = " << count << '\n';
-    }
+  // the incremental screen changes the candidates before any are written
+  std::unique_ptr<IncrementalScreen> screen;
+  unsigned live_primers = primers.size();
+  if (screened) {
+    ScreenParameters parameters = {tail_len, max_mismatches, j,
+        minimum_matching_jmers, minimum_lcs_threshold, coarse};
+    screen.reset(
+        new IncrementalScreen(parameters, threads, primers, candidates));
   }
-  std::cout << "\n";
-  std::cout << "========================================\n";
-  std::cout << "\n";
-  
-  std::cout << "total hits = " << count << '\n';
-  std::cout << "proportion of hits out of all pairs = " << (double)count / (primers.size() * primers.size()) << '\n';
 
-  return 0;
-}
-
-int hash(const std::string &str) {
-  int ret_val = 0;
-  for (auto i = 0u; i < str.size(); ++i) {
-    ret_val += pow(number_of_bases, i) * base_map[str[i]];
-  }
-  return ret_val;
-}
+  if (!append_file_name.empty()) {
+    auto added = ReadInputFile(append_file_name);
+    metrics.BeginStage("append");
+    auto start = std::chrono::steady_clock::now();
+    screen->Append(added);
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    metrics.EndStage();
+    metrics.Count("primers_appended", added.size());
+    live_primers += added.size();
+    metrics.Count("candidates", screen->Candidates().size());
 
-std::string ReverseComplement(const std::string &src) {
-  int len = src.size();
-  std::string ret_str = src;
-  for (int i = 0; i < len; ++i) {
-    ret_str[len - 1 - i] = complement_map[src[i]];
+    std::cout << "========================================\n";
+    std::cout << "Incremental append =====================\n";
+    std::cout << "========================================\n";
+    std::cout << "append_file_name = " << append_file_name << '\n';
+    std::cout << "primers appended = " << added.size() << '\n';
+    std::cout << "seconds = " << seconds << '\n';
+    std::cout << "total hits = " << screen->Candidates().size() << '\n';
+    std::cout << "========================================\n";
+    std::cout << "\n";
   }
-  return ret_str;
-}
 
-bool ValidSequence(std::string str) {
-  for (char c : str) {
-    if (c != 'A' && c != 'T' && c != 'C' && c != 'G') {
-      return false;
+  if (!remove_file_name.empty()) {
+    std::unordered_set<std::string> names = ReadNames(remove_file_name);
+    metrics.BeginStage("remove");
+    auto start = std::chrono::steady_clock::now();
+    const PrimerPanel &panel = screen->Primers();
+    unsigned removed_count = 0;
+    for (unsigned i = 0; i < panel.size(); ++i) {
+      if (screen->Removed(i) || names.count(panel.Name(i)) == 0) continue;
+      screen->Remove(i);
+      ++removed_count;
     }
-  }
-  return true;
-}
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    metrics.EndStage();
+    live_primers -= removed_count;
+    metrics.Count("primers_removed", removed_count);
+    metrics.Count("candidates", screen->Candidates().size());
 
-std::vector<PrimerClass> ReadInputFile(const std::string &input_file_name) {
-  std::ifstream instream(input_file_name);
-  if (!instream.is_open()) {
-    std::cout << "Could not open input file.\n";
-    std::exit(EXIT_FAILURE);
+    std::cout << "========================================\n";
+    std::cout << "Incremental remove =====================\n";
+    std::cout << "========================================\n";
+    std::cout << "remove_file_name = " << remove_file_name << '\n';
+    std::cout << "primers removed = " << removed_count << '\n';
+    std::cout << "seconds = " << seconds << '\n';
+    std::cout << "total hits = " << screen->Candidates().size() << '\n';
+    std::cout << "========================================\n";
+    std::cout << "\n";
   }
-  std::vector<PrimerClass> primers;
-  std::string name;
-  std::string sequence;
-  for (;;) {
-    std::getline(instream, name, ',');
-    std::getline(instream, sequence, ',');
-    std::transform(sequence.begin(), sequence.end(), sequence.begin(),
-      ::toupper);
-    instream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    if (instream.eof()) {
-      break;
-    } else {
-	    if (!ValidSequence(sequence)) {
-        std::cout << "Invalid sequence:\n";
-        std::cout << "primer name = " << name << "\n";
-        std::cout << "sequence = " << sequence << "\n";
-        std::exit(EXIT_FAILURE);
-      }
-      PrimerClass primer;
-      primer.SetName(name);
-      primer.SetSequence(sequence);
-      primers.push_back(primer);
-    }
-  }
-  instream.close();
-  return primers;
-}
-std::set<std::set<int>> kSubsets(int n, int k) {
-  // returns all k-subsets of {0, 1, ..., n-1}
-  if (k < 1) printf("ERROR: in kSubsets k must be >= 1");
-  if (k > n) printf("ERROR: in kSubsets k must be <= n");
 
-  std::set<std::set<int>> ret_set;
-  std::set<int> tmp_set;
-  std::vector<int> include_indexes;
-  for (int i = 0; i < k; ++i) include_indexes.push_back(i);
-
-  while (1) {
-    tmp_set.clear();
-    for (int i : include_indexes) tmp_set.insert(i);
-    ret_set.insert(tmp_set);
-    if (include_indexes[0] == (n-1)-(k-1)) break;
-
-    // update include_indexes
-    for (auto i = include_indexes.size() - 1; i >= 0; --i) {
-      if (i == include_indexes.size() - 1 && include_indexes[i] < n-1) {
-        ++include_indexes[i];
-        break;
-      } else if (i < include_indexes.size() - 1 && include_indexes[i] < include_indexes[i+1] - 1) {
-        ++include_indexes[i];
-        for (auto j = i + 1; j < include_indexes.size(); ++j) {
-          include_indexes[j] = include_indexes[j-1]+1;
-        }
-        break;
-      }
-    }
+  if (screened) {
+    candidates = screen->Candidates();
+    pairs = candidates.size();
   }
-  return ret_set;
-}
+  const PrimerPanel &panel = screened ? screen->Primers() : primers;
 
-std::set<std::string> kMismatch(std::string input_str, int max_mismatches) {
-  // returns a set of strings which have less than or equal to
-  // max_mismatches with input_str
-  std::set<std::string> ret_set;
-  int len = input_str.size();
-  if (max_mismatches < 0) {
-    printf("ERROR: in kMismatch, max_mismatches must be nonnegative.");
-    exit(EXIT_FAILURE);
-  } else if (max_mismatches == 0) {
-    ret_set.insert(input_str);
+  // final results; the writer thread goes on writing to an output file
+  // while the run continues, and stdout waits for it
+  metrics.BeginStage("output");
+  std::cout << "========================================\n";
+  std::cout << "Results: primer dimer candidates =======\n";
+  std::cout << "========================================\n";
+  if (ranking) std::cout << "top partners of each primer = " << options.top << '\n';
+  if (output_file != stdout) {
+    std::cout << "output_file_name = " << options.output_file_name << '\n';
   } else {
-    if (max_mismatches > len) max_mismatches = len;
-    std::set<std::set<int>> s = kSubsets(len, max_mismatches);
-    std::vector<int> include_indexes_sorted;
-    std::string tmp_str;
-    for (std::set<int> include_indexes : s) {
-      tmp_str = input_str;
-      include_indexes_sorted.clear();
-      for (int i : include_indexes) include_indexes_sorted.push_back(i);
-      std::sort(include_indexes_sorted.begin(), include_indexes_sorted.end());
-      if (include_indexes_sorted[0] == 0) {
-        continue;  // the 0th base (the 3' end) must match
-      }
-      for (int i : include_indexes_sorted) tmp_str[i] = 'A';
-      for (int j = 0; j < pow(number_of_bases, max_mismatches); j++) {
-        ret_set.insert(tmp_str);
-        for (auto i = 0u; i < include_indexes_sorted.size(); ++i) {
-          if (tmp_str[include_indexes_sorted[i]] != 'G') {
-            tmp_str[include_indexes_sorted[i]] = next_base[tmp_str[include_indexes_sorted[i]]];
-            for (auto u = 0u; u < i; ++u) tmp_str[include_indexes_sorted[u]] = 'A';
-            break;
-          }
-        }
-      }
+    writer.reset(new ResultWriter(output_file, options.output_format));
+  }
+  size_t count = pairs;
+  if (ranking) {
+    // the top partners of each primer, worst first
+    std::vector<Candidate> row;
+    count = 0;
+    for (unsigned i = 0; i < primers.size(); ++i) {
+      ranking->Row(i, &row);
+      writer->WriteRow(primers, i, row.data(), row.data() + row.size());
+      count += row.size();
     }
+  } else if (!stream) {
+    writer->WriteRows(panel, candidates);
   }
-  return ret_set;
-}
-
-std::vector<node_t*> LoadTailTable(std::vector<PrimerClass> primers, int tail_len,
-    int max_mismatches) {
-  std::vector<node_t*> table;
-  for (int i = 0; i < pow(number_of_bases, tail_len); ++i) table.push_back(nullptr);
-  std::string primer;
-  std::string tail;
-  std::string tail_rc;
-  std::set<std::string> similar_sequences;
-  int hash_val;
-  int primer_len;
-  for (int i = 0; i < static_cast<int>(primers.size()); ++i) {
-    primer = primers[i].GetSequence();
-    primer_len = primer.size();
-    tail = primer.substr(primer_len - tail_len, tail_len);
-    tail_rc = ReverseComplement(tail);
-    similar_sequences = kMismatch(tail_rc, max_mismatches);
-    for (std::string sequence : similar_sequences) {
-      hash_val = hash(sequence);
-      node_t* tmp_node_ptr = (node_t*) malloc(sizeof(node_t));
-      tmp_node_ptr->primer_index = i;
-      if (table[hash_val] == nullptr) {
-        tmp_node_ptr->next = nullptr;
-      } else {
-        tmp_node_ptr->next = table[hash_val];
-      }
-      table[hash_val] = tmp_node_ptr;
+  if (output_file == stdout) writer->Close();
+  std::cout << "\n";
+  std::cout << "========================================\n";
+  std::cout << "\n";
+  metrics.EndStage();
+  metrics.Count("candidates_written", count);
+  if (ranking) {
+    std::cout << "========================================\n";
+    std::cout << "Results: top pairs =====================\n";
+    std::cout << "========================================\n";
+    for (const RankedPair &pair : ranking->Global()) {
+      std::cout << "score = " << pair.score << " : "
+          << primers.Name(pair.primer) << " - "
+          << primers.Name(pair.candidate.partner) << " (jmers = "
+          << pair.candidate.jmers << ", lcs = " << pair.candidate.lcs_len
+          << ")\n";
     }
+    std::cout << "========================================\n";
+    std::cout << "\n";
+    // the totals are of every candidate, not only those listed
+    count = ranking->Pairs();
   }
-  return table;
-}
 
-std::vector<std::vector<bool>> MatchTails(std::vector<PrimerClass> primers,
-    int tail_len, int max_mismatches) {
-  std::vector<std::vector<bool>> hit;
-  std::vector<node_t*> table = LoadTailTable(primers, tail_len, max_mismatches);
-  std::vector<bool> zero_v(primers.size(), false);
-  for (auto i = 0u; i < primers.size(); ++i) hit.push_back(zero_v);
-  std::string tmp_primer;
-  std::string window;
-  node_t* tmp_node_ptr;
-  for (unsigned i = 0; i < primers.size(); ++i) {
-    tmp_primer = primers[i].GetSequence();
-    for (unsigned start_index = 0;
-        start_index + tail_len <= tmp_primer.size();
-        ++start_index) {
-      window = tmp_primer.substr(start_index, tail_len);
-      tmp_node_ptr = table[hash(window)];
-      while (tmp_node_ptr != nullptr) {
-        hit[i][tmp_node_ptr->primer_index] = true;
-        hit[tmp_node_ptr->primer_index][i] = true;
-        tmp_node_ptr = tmp_node_ptr->next;
-      }
+  std::cout << "total hits = " << count << '\n';
+  std::cout << "proportion of hits out of all pairs = " << (double)count / (live_primers * live_primers) << '\n';
+  std::cout << '\n';
+  pipeline.PrintStatistics(std::cout);
+
+  if (output_file != stdout) {
+    bool written = writer->Close();
+    if (fclose(output_file) != 0 || !written) {
+      std::cout << "Could not write output file.\n";
+      std::exit(EXIT_FAILURE);
     }
   }
-  return hit;
-}
 
-std::vector<std::vector<bool>> LoadJmerTable(std::vector<PrimerClass> primers,
-    unsigned j, bool rc, bool coarse) {
-  std::vector<std::vector<bool>> jmer_table;
-  std::vector<bool> false_v(primers.size(), false);
-  for (int i = 0; i < pow(number_of_bases, j); ++i) {
-    jmer_table.push_back(false_v);
-  }
-  std::string primer;
-  std::string jmer;
-  int hash_val;
-  for (unsigned i = 0; i < primers.size(); ++i) {
-    primer = primers[i].GetSequence();
-    if (rc) primer = ReverseComplement(primer);
-    std::string jmer;
-    for (unsigned start_index = 0; start_index + j <= primer.size();) {
-      jmer = primer.substr(start_index, j);
-      hash_val = hash(jmer);
-      jmer_table[hash_val][i] = true;
-      if (coarse) {
-        start_index += j;
-      } else {
-        ++start_index;
-      }
+  if (!options.metrics_file_name.empty()) {
+    std::ofstream metrics_file(options.metrics_file_name);
+    metrics.Write(metrics_file);
+    if (!metrics_file) {
+      std::cout << "Could not write metrics file.\n";
+      std::exit(EXIT_FAILURE);
     }
   }
-  return jmer_table;
+
+  return 0;
 }
 
-std::vector<std::vector<unsigned>> MatchJmers(std::vector<PrimerClass> primers,
-    int j, bool coarse) {
-  std::vector<std::vector<unsigned>> hit;
-  auto jmer_table = LoadJmerTable(primers, j, false, false);
-  auto jmer_rc_table = LoadJmerTable(primers, j, true, coarse);
-  std::vector<unsigned> zero_v(primers.size(), 0);
-  for (unsigned i = 0; i < primers.size(); ++i) hit.push_back(zero_v);
-  int matches;
-  std::vector<int> all_matches;
-  for (unsigned i = 0; i < primers.size(); ++i) {
-    //if (i%300 == 0) std::cout << i << '\n';
-    for (unsigned k = i; k < primers.size(); ++k) {
-      matches = 0;
-      for (unsigned p = 0; p < jmer_table.size(); ++p) {
-        if (jmer_rc_table[p][i] == true &&
-            jmer_table[p][k] == true) {
-          ++matches;
-        }
-      }
-      hit[i][k] = hit[k][i] = matches;
-      all_matches.push_back(matches);
-    }
+
+PrimerPanel ReadInputFile(const std::string &input_file_name) {
+  PrimerPanel primers;
+  std::string error;
+  if (!ReadPanelFile(input_file_name, &primers, &error)) {
+    std::cout << error << '\n';
+    std::exit(EXIT_FAILURE);
   }
+  return primers;
+}
 
-  /*
-  printf("avg matches = %f\n", std::accumulate(all_matches.begin(), all_matches.end(), 0ull)/(double)all_matches.size());
-  printf("all_matches.size() = %f\n", (double)all_matches.size());
-  std::vector<int> stats(jmer_table.size(), 0);
-  for (int match : all_matches) {
-    ++stats[match];
+// the names of file_name, one per line; a line may go on after a comma,
+// so a panel file lists its own names
+std::unordered_set<std::string> ReadNames(const std::string &file_name) {
+  std::ifstream file(file_name);
+  if (!file) {
+    std::cout << "Could not read " << file_name << '\n';
+    std::exit(EXIT_FAILURE);
   }
-  for (auto i = 0u; i < stats.size(); ++i) {
-    if (stats[i] != 0) {
-      printf("matches = %-10i, occurrences = %-10i, prob = %-10f\n", i, stats[i], stats[i]/(double)all_matches.size());
-    }
+  std::unordered_set<std::string> names;
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find(','));
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (!line.empty()) names.insert(line);
   }
-  */
-
-  return hit;
+  return names;
 }
 
-unsigned LcsLen(std::string str1, std::string str2) {
-  unsigned lcs_len = 0;
-  unsigned len1 = str1.size();
-  unsigned len2 = str2.size();
-  unsigned rows = len2 + 1;
-  unsigned cols = len1 + 1;
-  std::vector<unsigned> zero_v(cols, 0);
-  std::vector<std::vector<unsigned>> table;
-  for (unsigned row = 0; row < rows; ++row) table.push_back(zero_v);
-  for (unsigned row = 1; row < rows; ++row) {
-    for (unsigned col = 1; col < cols; ++col) {
-      if (str1.at(col-1) == str2.at(row-1)) {
-        table.at(row).at(col) = table.at(row-1).at(col-1)+1;
-        lcs_len = std::max(lcs_len, table.at(row).at(col));
-      } else {
-        table.at(row).at(col) = 0;
-      }
-    }
+// the windows of k bases in all the primers
+unsigned long long NumberOfWindows(const PrimerPanel &primers, unsigned k) {
+  unsigned long long windows = 0;
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    if (primers.Length(i) >= k) windows += primers.Length(i) - k + 1;
   }
-  return lcs_len;
+  return windows;
 }
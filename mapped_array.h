@@ -0,0 +1,96 @@
+#ifndef MAPPED_ARRAY_H
+#define MAPPED_ARRAY_H
+
+#include <stddef.h>     // for size_t
+
+#include <vector>       // for std::vector
+
+// An array which either owns its elements, while a structure is being
+// built, or views elements stored elsewhere, such as in a memory-mapped
+// index file. The modifying members may only be used on an owned array;
+// a copy of a view owns a copy of the elements.
+template <typename T>
+class MappedArray {
+ public:
+  MappedArray() {}
+  MappedArray(size_t size, const T &value) : owned_(size, value) {}
+  MappedArray(const MappedArray &other) : owned_(other.begin(), other.end()) {}
+  MappedArray(MappedArray &&other) = default;
+  MappedArray &operator=(const MappedArray &other) {
+    if (this != &other) {
+      owned_.assign(other.begin(), other.end());
+      view_ = nullptr;
+      size_ = 0;
+    }
+    return *this;
+  }
+  MappedArray &operator=(MappedArray &&other) = default;
+
+  // views the size elements at data, which must outlive the array
+  void View(const T* data, size_t size) {
+    std::vector<T>().swap(owned_);
+    view_ = data;
+    size_ = size;
+  }
+  bool IsView() const {
+    return view_ != nullptr;
+  }
+
+  const T* data() const {
+    return view_ ? view_ : owned_.data();
+  }
+  size_t size() const {
+    return view_ ? size_ : owned_.size();
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+  const T &operator[](size_t i) const {
+    return data()[i];
+  }
+  const T* begin() const {
+    return data();
+  }
+  const T* end() const {
+    return data() + size();
+  }
+  const T &back() const {
+    return end()[-1];
+  }
+
+  T &operator[](size_t i) {
+    return owned_[i];
+  }
+  T &back() {
+    return owned_.back();
+  }
+  void push_back(const T &value) {
+    owned_.push_back(value);
+  }
+  void resize(size_t size, const T &value = T()) {
+    owned_.resize(size, value);
+  }
+  void reserve(size_t size) {
+    owned_.reserve(size);
+  }
+  void assign(size_t size, const T &value) {
+    owned_.assign(size, value);
+  }
+  template <typename Iterator>
+  void append(Iterator first, Iterator last) {
+    owned_.insert(owned_.end(), first, last);
+  }
+  // frees the elements, owned or not
+  void Release() {
+    std::vector<T>().swap(owned_);
+    view_ = nullptr;
+    size_ = 0;
+  }
+
+ private:
+  std::vector<T> owned_;
+  const T* view_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "metrics.h"
+
+#include <malloc.h>     // for mallinfo2()
+#include <stdlib.h>     // for strtod()
+#include <sys/resource.h>  // for getrusage()
+#include <time.h>       // for clock_gettime()
+
+#include <sstream>      // for std::ostringstream
+
+namespace {
+
+// the CPU time of all the threads of the process
+double CpuSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// the bytes malloc has handed out and not had back, including blocks it
+// mapped on their own
+long long HeapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+std::string JsonString(const std::string &value) {
+  std::string quoted = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      const char* hex = "0123456789abcdef";
+      quoted += "\\u00";
+      quoted += hex[c >> 4];
+      quoted += hex[c & 15];
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+std::string JsonNumber(double value) {
+  std::ostringstream out;
+  out.precision(9);
+  out << value;
+  return out.str();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+Metrics::Metrics()
+    : start_(std::chrono::steady_clock::now()),
+      start_cpu_seconds_(CpuSeconds()) {}
+
+void Metrics::Value(const std::string &name, const std::string &value) {
+  values_.push_back(std::make_pair(name, JsonString(value)));
+}
+
+void Metrics::Value(const std::string &name, unsigned long long value) {
+  values_.push_back(std::make_pair(name, std::to_string(value)));
+}
+
+void Metrics::BeginStage(const std::string &name) {
+  stages_.push_back(Stage());
+  stages_.back().name = name;
+  stage_start_heap_bytes_ = HeapBytes();
+  stage_start_cpu_seconds_ = CpuSeconds();
+  stage_start_ = std::chrono::steady_clock::now();
+}
+
+void Metrics::EndStage() {
+  Stage &stage = stages_.back();
+  stage.wall_seconds = SecondsSince(stage_start_);
+  stage.cpu_seconds = CpuSeconds() - stage_start_cpu_seconds_;
+  stage.heap_bytes = HeapBytes();
+  stage.heap_bytes_added = stage.heap_bytes - stage_start_heap_bytes_;
+}
+
+void Metrics::Count(const std::string &name, unsigned long long value) {
+  stages_.back().counts.push_back(std::make_pair(name, std::to_string(value)));
+}
+
+void Metrics::Seconds(const std::string &name, double seconds) {
+  stages_.back().counts.push_back(std::make_pair(name, JsonNumber(seconds)));
+}
+
+double Metrics::Number(const std::string &name) const {
+  if (stages_.empty()) return 0;
+  for (const auto &count : stages_.back().counts) {
+    if (count.first == name) return strtod(count.second.c_str(), nullptr);
+  }
+  return 0;
+}
+
+void Metrics::Write(std::ostream &out) const {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  out << "{\n";
+  for (const auto &value : values_) {
+    out << "  " << JsonString(value.first) << ": " << value.second << ",\n";
+  }
+  out << "  \"wall_seconds\": " << JsonNumber(SecondsSince(start_)) << ",\n";
+  out << "  \"cpu_seconds\": "
+      << JsonNumber(CpuSeconds() - start_cpu_seconds_) << ",\n";
+  // ru_maxrss is in kilobytes
+  out << "  \"peak_rss_bytes\": " << usage.ru_maxrss * 1024ll << ",\n";
+  out << "  \"stages\": [";
+  for (unsigned s = 0; s < stages_.size(); ++s) {
+    const Stage &stage = stages_[s];
+    out << (s == 0 ? "\n" : ",\n");
+    out << "    {\n";
+    out << "      \"name\": " << JsonString(stage.name) << ",\n";
+    out << "      \"wall_seconds\": " << JsonNumber(stage.wall_seconds) << ",\n";
+    out << "      \"cpu_seconds\": " << JsonNumber(stage.cpu_seconds) << ",\n";
+    out << "      \"heap_bytes\": " << stage.heap_bytes << ",\n";
+    out << "      \"heap_bytes_added\": " << stage.heap_bytes_added << ",\n";
+    out << "      \"counts\": {";
+    for (unsigned c = 0; c < stage.counts.size(); ++c) {
+      out << (c == 0 ? "\n" : ",\n");
+      out << "        " << JsonString(stage.counts[c].first) << ": "
+          << stage.counts[c].second;
+    }
+    out << (stage.counts.empty() ? "}\n" : "\n      }\n");
+    out << "    }";
+  }
+  out << (stages_.empty() ? "]\n" : "\n  ]\n");
+  out << "}\n";
+}
@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>       // for std::chrono::steady_clock
+#include <iostream>     // for std::ostream
+#include <string>       // for std::string
+#include <utility>      // for std::pair
+#include <vector>       // for std::vector
+
+// Measurements of one run, stage by stage, written as a JSON document. A
+// stage is timed from BeginStage to EndStage in wall time and in the CPU
+// time of every thread of the process, and notes the heap in use when it
+// ends and how much that grew over the stage; the items it handled are
+// added with Count. Recording a stage reads a few clocks and the malloc
+// statistics, so metrics can be kept for every run.
+class Metrics {
+ public:
+  Metrics();
+
+  // a value describing the whole run, such as a parameter
+  void Value(const std::string &name, const std::string &value);
+  void Value(const std::string &name, unsigned long long value);
+
+  void BeginStage(const std::string &name);
+  void EndStage();
+  // a count or time of the stage begun last
+  void Count(const std::string &name, unsigned long long value);
+  void Seconds(const std::string &name, double seconds);
+  // the count or time name of the stage begun last, 0 if it has none
+  double Number(const std::string &name) const;
+
+  // the run's values, its totals up to now, peak RSS and stages
+  void Write(std::ostream &out) const;
+
+ private:
+  struct Stage {
+    std::string name;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    long long heap_bytes = 0;
+    long long heap_bytes_added = 0;
+    // counts and times as JSON numbers
+    std::vector<std::pair<std::string, std::string>> counts;
+  };
+
+  std::chrono::steady_clock::time_point start_;
+  double start_cpu_seconds_;
+  // values as JSON strings or numbers
+  std::vector<std::pair<std::string, std::string>> values_;
+  std::vector<Stage> stages_;
+  std::chrono::steady_clock::time_point stage_start_;
+  double stage_start_cpu_seconds_ = 0;
+  long long stage_start_heap_bytes_ = 0;
+};
+
+#endif
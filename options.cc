@@ -0,0 +1,159 @@
+#include "options.h"
+
+bool ParseOptions(int argc, char* argv[], Options* options,
+    std::string* error) {
+  for (int a = 1; a < argc; ++a) {
+    std::string option = argv[a];
+    if (option == "--help" || option == "-h") {
+      options->help = true;
+      return true;
+    }
+    if (option.compare(0, 2, "--") != 0) {
+      if (!options->input_file_name.empty()) {
+        *error = "more than one input file: " + option;
+        return false;
+      }
+      options->input_file_name = option;
+      continue;
+    }
+    if (option == "--coarse") {
+      options->coarse = true;
+      continue;
+    }
+    if (a + 1 == argc) {
+      *error = option + " needs a value";
+      return false;
+    }
+    std::string value = argv[++a];
+    unsigned* number = ThresholdOption(option, options);
+    if (option == "--threads") {
+      number = &options->threads;
+    } else if (option == "--tail-index") {
+      if (value == "auto") {
+        options->tail_index = kAutomaticTailIndex;
+      } else if (value == "dense") {
+        options->tail_index = kDenseTailIndex;
+      } else if (value == "sparse") {
+        options->tail_index = kSparseTailIndex;
+      } else {
+        *error = "--tail-index must be auto, dense or sparse";
+        return false;
+      }
+    } else if (option == "--lcs-filter") {
+      if (value == "dp") {
+        options->lcs_filter = kDpLcsFilter;
+      } else if (value == "join") {
+        options->lcs_filter = kJoinLcsFilter;
+      } else if (value == "suffix") {
+        options->lcs_filter = kSuffixArrayLcsFilter;
+      } else {
+        *error = "--lcs-filter must be dp, join or suffix";
+        return false;
+      }
+    } else if (option == "--output-format") {
+      if (value == "text") {
+        options->output_format = kTextOutput;
+      } else if (value == "tsv") {
+        options->output_format = kTsvOutput;
+      } else if (value == "binary") {
+        options->output_format = kBinaryOutput;
+      } else {
+        *error = "--output-format must be text, tsv or binary";
+        return false;
+      }
+    } else if (option == "--top") {
+      number = &options->top;
+    } else if (option == "--rank-by") {
+      if (value == "jmers") {
+        options->rank_by = kRankByJmers;
+      } else if (value == "lcs") {
+        options->rank_by = kRankByLcs;
+      } else if (value == "tail") {
+        options->rank_by = kRankByTail;
+      } else if (value == "combined") {
+        options->rank_by = kRankByCombined;
+      } else {
+        *error = "--rank-by must be jmers, lcs, tail or combined";
+        return false;
+      }
+    } else if (option == "--output") {
+      options->output_file_name = value;
+    } else if (option == "--append") {
+      options->append_file_name = value;
+    } else if (option == "--remove") {
+      options->remove_file_name = value;
+    } else if (option == "--write-index") {
+      options->index_file_name = value;
+    } else if (option == "--metrics") {
+      options->metrics_file_name = value;
+    } else if (number == nullptr) {
+      *error = "unknown option " + option;
+      return false;
+    }
+    if (number != nullptr && !ParseUnsigned(option, value, number, error)) {
+      return false;
+    }
+  }
+
+  if (options->input_file_name.empty()) {
+    *error = "please supply one input argument, the input file path";
+    return false;
+  }
+  if (!CheckThresholds(*options, error)) return false;
+  if (options->top > 0 && !options->append_file_name.empty()) {
+    *error = "--top cannot be used with --append";
+    return false;
+  }
+  if (options->top > 0 && !options->remove_file_name.empty()) {
+    *error = "--top cannot be used with --remove";
+    return false;
+  }
+  if (options->output_format == kBinaryOutput
+      && options->output_file_name.empty()) {
+    *error = "--output-format binary needs --output";
+    return false;
+  }
+  return true;
+}
+
+void PrintUsage(std::ostream &out) {
+  Options defaults;
+  out << "usage: main input_file [options]\n"
+      << "  --tail-len N          bases of the 3' tail to match ("
+      << defaults.tail_len << ")\n"
+      << "  --max-mismatches N    mismatches allowed in a tail ("
+      << defaults.max_mismatches << ")\n"
+      << "  --jmer-len N          the length of a j-mer (" << defaults.j << ")\n"
+      << "  --min-jmers N         j-mers a pair must share ("
+      << defaults.minimum_matching_jmers << ")\n"
+      << "  --min-lcs N           longest common substring a pair needs, 0 to"
+      << " skip (" << defaults.minimum_lcs_threshold << ")\n"
+      << "  --coarse              parse one primer of each pair in"
+      << " non-overlapping j-mers\n"
+      << "  --threads N           worker threads, 0 for one per core ("
+      << defaults.threads << ")\n"
+      << "  --tail-index I        auto, dense or sparse tail tables (auto)\n"
+      << "  --lcs-filter F        test --min-lcs by dp on each pair, a join of"
+      << " shared t-mers, or\n"
+      << "                        a suffix array giving the exact lcs (join)\n"
+      << "  --top K               keep only the K worst partners of each"
+      << " primer, and the K\n"
+      << "                        worst pairs overall, rather than every"
+      << " candidate\n"
+      << "  --rank-by R           rank by jmers, lcs, tail (matched tail bases)"
+      << " or combined,\n"
+      << "                        their sum (combined)\n"
+      << "  --output file         write the candidates to file rather than"
+      << " stdout\n"
+      << "  --output-format F     text, tsv (a pair per line with its scores)"
+      << " or binary (text)\n"
+      << "  --append file         screen the primers of file against the"
+      << " panel incrementally\n"
+      << "  --remove file         remove the primers named in file, one name"
+      << " per line (or csv),\n"
+      << "                        from the screened panel\n"
+      << "  --write-index file    save the panel and its tables as an index\n"
+      << "  --metrics file        write the time, memory and item counts of"
+      << " each stage as JSON\n"
+      << "  --help, -h            print this list and exit\n";
+}
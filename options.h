@@ -0,0 +1,38 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <iostream>     // for std::ostream
+#include <string>       // for std::string
+
+#include "arguments.h"
+#include "lcs_join.h"
+#include "ranking.h"
+#include "result_writer.h"
+#include "tail_table.h"
+
+// The settings of a run of main, from its command line. Each has the
+// default the constants at the top of main.cc used to have.
+struct Options : Thresholds {
+  std::string input_file_name;
+  std::string append_file_name;   // primers to screen incrementally
+  std::string remove_file_name;   // primers to remove incrementally
+  std::string index_file_name;    // a file to save the panel index to
+  std::string metrics_file_name;  // a file to write the run's metrics to
+  std::string output_file_name;   // a file for the candidates, not stdout
+  unsigned threads = 0;  // 0 means one thread per core
+  TailIndex tail_index = kAutomaticTailIndex;
+  LcsFilter lcs_filter = kJoinLcsFilter;
+  OutputFormat output_format = kTextOutput;
+  unsigned top = 0;  // the partners kept for each primer, 0 for all
+  RankBy rank_by = kRankByCombined;
+  bool help = false;  // --help or -h: print the usage and nothing else
+};
+
+// Reads the input file name and options of argv into options, returning
+// false with a message in error if any is unknown, lacks its value or has
+// a value out of range. On --help or -h it sets help and stops there.
+bool ParseOptions(int argc, char* argv[], Options* options,
+    std::string* error);
+void PrintUsage(std::ostream &out);
+
+#endif
@@ -0,0 +1,416 @@
+#include "pair_kernel.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>  // for AVX2 intrinsics
+#endif
+
+#include <algorithm>    // for std::sort, std::min, std::max, std::swap
+#include <utility>      // for std::pair
+
+#include "kmer.h"
+#include "lcs.h"
+
+namespace {
+
+// RunsOfAtLeast without its early exit, so that the steps taken depend only
+// on len and are predicted on every diagonal
+inline uint64_t RunStarts(uint64_t x, unsigned len) {
+  for (unsigned have = 1; have < len;) {
+    unsigned shift = have < len - have ? have : len - have;
+    x &= x >> shift;
+    have += shift;
+  }
+  return x;
+}
+
+#if defined(__x86_64__)
+// RunStarts in each 64-bit lane
+__attribute__((target("avx2")))
+inline __m256i RunStartsAvx2(__m256i x, unsigned len) {
+  for (unsigned have = 1; have < len;) {
+    unsigned shift = have < len - have ? have : len - have;
+    x = _mm256_and_si256(x, _mm256_srl_epi64(x, _mm_cvtsi32_si128(shift)));
+    have += shift;
+  }
+  return x;
+}
+
+// all ones in the lanes where the tail mismatches x, already cut to the
+// tail, miss end and number at most max_mismatches
+__attribute__((target("avx2")))
+inline __m256i TailMatchesAvx2(__m256i x, __m256i end,
+    unsigned max_mismatches) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i ok = _mm256_cmpeq_epi64(_mm256_and_si256(x, end), zero);
+  // clearing the lowest set bit max_mismatches times leaves nothing
+  const __m256i one = _mm256_set1_epi64x(1);
+  for (unsigned m = 0; m < max_mismatches; ++m) {
+    x = _mm256_and_si256(x, _mm256_sub_epi64(x, one));
+  }
+  return _mm256_and_si256(ok, _mm256_cmpeq_epi64(x, zero));
+}
+
+__attribute__((target("avx2")))
+inline __m256i LoadLanes(const uint64_t* words) {
+  return _mm256_load_si256(reinterpret_cast<const __m256i*>(words));
+}
+
+// UpdateLongestRun in each lane, skipped unless some lane holds a run
+// longer than least, the shortest of lens
+__attribute__((target("avx2")))
+inline void UpdateLongestRunsAvx2(__m256i matches, unsigned* lens,
+    unsigned* least) {
+  __m256i longer = RunStartsAvx2(matches, *least + 1);
+  if (_mm256_testz_si256(longer, longer)) return;
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), matches);
+  *least = 64;
+  for (unsigned t = 0; t < 4; ++t) {
+    UpdateLongestRun(lanes[t], &lens[t]);
+    *least = std::min(*least, lens[t]);
+  }
+}
+
+// Scores rc(primer a) against the four primers b, all of up to 64 bases,
+// one per 64-bit lane: each diagonal is taken by the four pairs at once,
+// and the few diagonals which lengthen a common substring are finished
+// lane by lane.
+__attribute__((target("avx2")))
+void ScoreLanesAvx2(const PrimerPanel &primers, unsigned a, const unsigned* b,
+    unsigned tail_len, unsigned max_mismatches, unsigned j,
+    const uint64_t* counted, PairScores* scores) {
+  const uint64_t* rc = primers.RcPlanes(a);
+  const unsigned len_a = primers.Length(a);
+  const uint64_t valid_a = LowMask(len_a);
+  alignas(32) uint64_t lo[4], hi[4], valid[4], tail_mask[4], tail_end[4],
+      lens[4];
+  unsigned max_len_b = 0;
+  for (unsigned t = 0; t < 4; ++t) {
+    unsigned len = primers.Length(b[t]);
+    lo[t] = primers.Planes(b[t])[0];
+    hi[t] = primers.Planes(b[t])[1];
+    valid[t] = LowMask(len);
+    tail_mask[t] = len >= tail_len ? valid[t] & ~LowMask(len - tail_len) : 0;
+    tail_end[t] = len > 0 ? 1ull << (len - 1) : 0;
+    lens[t] = len;
+    max_len_b = std::max(max_len_b, len);
+  }
+  const __m256i b_lo = LoadLanes(lo), b_hi = LoadLanes(hi),
+      valid_b = LoadLanes(valid), b_tail_mask = LoadLanes(tail_mask),
+      b_tail_end = LoadLanes(tail_end), len_b = LoadLanes(lens);
+  const __m256i a_tail_mask = _mm256_set1_epi64x(LowMask(tail_len));
+  const __m256i a_tail_end = _mm256_set1_epi64x(1);
+  const __m256i zero = _mm256_setzero_si256();
+  // the lanes where b is long enough for a tail
+  const __m256i tail_b = _mm256_cmpgt_epi64(len_b,
+      _mm256_set1_epi64x(static_cast<int64_t>(tail_len) - 1));
+  __m256i found = zero;
+  __m256i tail = zero;
+  unsigned lcs_lens[4] = {0, 0, 0, 0};
+  unsigned least_lcs = 0;
+
+  // a shifted down: bit p compares base p + shift of a with base p of b
+  for (unsigned shift = 0; shift < len_a; ++shift) {
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m256i overlap = _mm256_and_si256(
+        _mm256_set1_epi64x(valid_a >> shift), valid_b);
+    __m256i differ = _mm256_or_si256(
+        _mm256_xor_si256(_mm256_set1_epi64x(rc[0] >> shift), b_lo),
+        _mm256_xor_si256(_mm256_set1_epi64x(rc[1] >> shift), b_hi));
+    __m256i matches = _mm256_andnot_si256(differ, overlap);
+    UpdateLongestRunsAvx2(matches, lcs_lens, &least_lcs);
+    if (j > 0) {
+      found = _mm256_or_si256(found,
+          _mm256_sll_epi64(RunStartsAvx2(matches, j), count));
+    }
+    __m256i mismatches = _mm256_andnot_si256(matches, overlap);
+    // the tail of b inside a, in the lanes where b ends within a
+    __m256i inside = _mm256_and_si256(tail_b, _mm256_cmpgt_epi64(
+        _mm256_set1_epi64x(static_cast<int64_t>(len_a) - shift + 1), len_b));
+    tail = _mm256_or_si256(tail, _mm256_and_si256(inside, TailMatchesAvx2(
+        _mm256_and_si256(mismatches, b_tail_mask), b_tail_end,
+        max_mismatches)));
+    if (shift == 0 && tail_len <= len_a) {
+      // the tail of a, in the lanes where b is long enough for it
+      tail = _mm256_or_si256(tail, _mm256_and_si256(tail_b,
+          TailMatchesAvx2(_mm256_and_si256(mismatches, a_tail_mask),
+              a_tail_end, max_mismatches)));
+    }
+  }
+  // b shifted down: bit p compares base p of a with base p + shift of b
+  for (unsigned shift = 1; shift < max_len_b; ++shift) {
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m256i overlap = _mm256_and_si256(_mm256_set1_epi64x(valid_a),
+        _mm256_srl_epi64(valid_b, count));
+    __m256i differ = _mm256_or_si256(
+        _mm256_xor_si256(_mm256_set1_epi64x(rc[0]),
+            _mm256_srl_epi64(b_lo, count)),
+        _mm256_xor_si256(_mm256_set1_epi64x(rc[1]),
+            _mm256_srl_epi64(b_hi, count)));
+    __m256i matches = _mm256_andnot_si256(differ, overlap);
+    UpdateLongestRunsAvx2(matches, lcs_lens, &least_lcs);
+    if (j > 0) found = _mm256_or_si256(found, RunStartsAvx2(matches, j));
+    __m256i mismatches = _mm256_andnot_si256(matches, overlap);
+    // the end of b is len_b - shift into a: the tail of b fits when that is
+    // at least tail_len and at most len_a, and the tail of a when it is at
+    // least tail_len
+    __m256i end_b = _mm256_sub_epi64(len_b, _mm256_set1_epi64x(shift));
+    __m256i holds_tail = _mm256_cmpgt_epi64(end_b,
+        _mm256_set1_epi64x(static_cast<int64_t>(tail_len) - 1));
+    __m256i within_a = _mm256_cmpgt_epi64(
+        _mm256_set1_epi64x(static_cast<int64_t>(len_a) + 1), end_b);
+    tail = _mm256_or_si256(tail, _mm256_and_si256(_mm256_and_si256(tail_b,
+        _mm256_and_si256(holds_tail, within_a)), TailMatchesAvx2(
+            _mm256_and_si256(_mm256_sll_epi64(mismatches, count),
+                b_tail_mask), b_tail_end, max_mismatches)));
+    if (tail_len <= len_a) {
+      tail = _mm256_or_si256(tail, _mm256_and_si256(holds_tail,
+          TailMatchesAvx2(_mm256_and_si256(mismatches, a_tail_mask),
+              a_tail_end, max_mismatches)));
+    }
+  }
+
+  alignas(32) uint64_t found_lanes[4], tail_lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(found_lanes), found);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(tail_lanes), tail);
+  for (unsigned t = 0; t < 4; ++t) {
+    scores[t].tail = tail_lanes[t] != 0;
+    scores[t].jmers = __builtin_popcountll(found_lanes[t] & counted[0]);
+    scores[t].lcs_len = lcs_lens[t];
+  }
+}
+
+bool UseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+const bool use_avx2 = UseAvx2();
+#endif
+
+}  // namespace
+
+PairKernel::PairKernel(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned j, bool coarse)
+    : primers_(primers), tail_len_(tail_len), max_mismatches_(max_mismatches),
+      j_(j) {
+  std::vector<std::pair<kmer_t, unsigned>> jmers;
+  counted_offsets_.push_back(0);
+  for (unsigned i = 0; i < primers.size(); ++i) {
+    unsigned len = primers.Length(i);
+    counted_.resize(counted_.size() + (len + 63) / 64, 0);
+    uint64_t* counted = &counted_[counted_offsets_.back()];
+    counted_offsets_.push_back(counted_.size());
+    if (j == 0 || len < j) continue;
+
+    // the j-mers of the reverse complement by position, first occurrence
+    // first
+    jmers.clear();
+    kmer_t code = 0;
+    for (unsigned p = 0; p < len; ++p) {
+      code = ((code << 2) | primers.RcBase(i, p)) & KmerMask(j);
+      if (p + 1 < j) continue;
+      unsigned start = p + 1 - j;
+      if (coarse && start % j != 0) continue;
+      jmers.push_back(std::make_pair(code, start));
+    }
+    std::sort(jmers.begin(), jmers.end());
+    for (unsigned t = 0; t < jmers.size(); ++t) {
+      if (t > 0 && jmers[t].first == jmers[t - 1].first) continue;
+      counted[jmers[t].second / 64] |= 1ull << (jmers[t].second % 64);
+    }
+  }
+}
+
+PairScores PairKernel::Score(unsigned i, unsigned k) const {
+  if (k < i) std::swap(i, k);
+  if (primers_.Length(i) <= 64 && primers_.Length(k) <= 64) {
+    return ScorePacked(i, k);
+  }
+  return ScoreScan(i, k);
+}
+
+void PairKernel::ScoreBatch(unsigned i, const unsigned* partners,
+    unsigned count, PairScores* scores) const {
+  unsigned t = 0;
+#if defined(__x86_64__)
+  // the partners after i, both primers packed, four lanes at a time
+  if (use_avx2 && primers_.Length(i) <= 64) {
+    unsigned lanes[4];
+    unsigned slots[4];
+    unsigned filled = 0;
+    for (; t < count; ++t) {
+      if (partners[t] < i || primers_.Length(partners[t]) > 64) {
+        scores[t] = Score(i, partners[t]);
+        continue;
+      }
+      lanes[filled] = partners[t];
+      slots[filled] = t;
+      if (++filled < 4) continue;
+      PairScores group[4];
+      ScoreLanesAvx2(primers_, i, lanes, tail_len_, max_mismatches_, j_,
+          &counted_[counted_offsets_[i]], group);
+      for (unsigned l = 0; l < filled; ++l) scores[slots[l]] = group[l];
+      filled = 0;
+    }
+    if (filled > 0) {
+      // an incomplete group repeats its last partner
+      for (unsigned l = filled; l < 4; ++l) lanes[l] = lanes[filled - 1];
+      PairScores group[4];
+      ScoreLanesAvx2(primers_, i, lanes, tail_len_, max_mismatches_, j_,
+          &counted_[counted_offsets_[i]], group);
+      for (unsigned l = 0; l < filled; ++l) scores[slots[l]] = group[l];
+    }
+    return;
+  }
+#endif
+  for (; t < count; ++t) scores[t] = Score(i, partners[t]);
+}
+
+unsigned PairKernel::TailMismatches(unsigned i, unsigned k) const {
+  if (k < i) std::swap(i, k);
+  const unsigned a = i, b = k;
+  const int len_a = primers_.Length(a), len_b = primers_.Length(b);
+  const int tail_len = tail_len_;
+  unsigned fewest = tail_len_ + 1;
+  // the tail of b, its 3' end on the last base of b, against rc(a) with
+  // base q of b on base q + d of rc(a)
+  if (len_b >= tail_len) {
+    for (int d = tail_len - len_b; d <= len_a - len_b; ++d) {
+      if (primers_.RcBase(a, len_b - 1 + d) != primers_.Base(b, len_b - 1)) {
+        continue;
+      }
+      unsigned mismatches = 0;
+      for (int q = len_b - tail_len; q < len_b - 1; ++q) {
+        mismatches += primers_.RcBase(a, q + d) != primers_.Base(b, q);
+      }
+      fewest = std::min(fewest, mismatches);
+    }
+  }
+  // the tail of a, its 3' end on the first base of rc(a), against b with
+  // base p of rc(a) on base p + e of b
+  if (len_a >= tail_len) {
+    for (int e = 0; e <= len_b - tail_len; ++e) {
+      if (primers_.RcBase(a, 0) != primers_.Base(b, e)) continue;
+      unsigned mismatches = 0;
+      for (int p = 1; p < tail_len; ++p) {
+        mismatches += primers_.RcBase(a, p) != primers_.Base(b, p + e);
+      }
+      fewest = std::min(fewest, mismatches);
+    }
+  }
+  return fewest;
+}
+
+PairScores PairKernel::ScorePacked(unsigned a, unsigned b) const {
+  const uint64_t* rc = primers_.RcPlanes(a);
+  const uint64_t* planes = primers_.Planes(b);
+  const uint64_t a_lo = rc[0], a_hi = rc[1], b_lo = planes[0],
+      b_hi = planes[1];
+  const unsigned len_a = primers_.Length(a), len_b = primers_.Length(b);
+  const uint64_t valid_a = LowMask(len_a), valid_b = LowMask(len_b);
+  const unsigned tail_len = tail_len_;
+  // a diagonal can still matter while it overlaps the least of a j-mer, a
+  // tail and a longer common substring
+  const unsigned least = std::max(std::min(j_, tail_len), 1u);
+  // the tail of b, its 3' end on the last base of b, and the tail of a, its
+  // 3' end on the first base of a
+  const bool tail_b = len_b >= tail_len;
+  const uint64_t tail_b_mask = valid_b & ~LowMask(len_b - tail_len);
+  const uint64_t tail_b_end = 1ull << (len_b - 1);
+  const uint64_t tail_a_mask = LowMask(tail_len);
+  PairScores scores = {false, 0, 0};
+  uint64_t found = 0;  // the positions of a whose j-mer occurs in b
+
+  // a shifted down: bit p compares base p + shift of a with base p of b
+  for (unsigned shift = 0;
+      shift < len_a && len_a - shift > std::min(scores.lcs_len, least - 1);
+      ++shift) {
+    uint64_t overlap = (valid_a >> shift) & valid_b;
+    uint64_t matches = ~(((a_lo >> shift) ^ b_lo) | ((a_hi >> shift) ^ b_hi))
+        & overlap;
+    if (RunStarts(matches, scores.lcs_len + 1)) {
+      UpdateLongestRun(matches, &scores.lcs_len);
+    }
+    if (j_ > 0) found |= RunStarts(matches, j_) << shift;
+    if (scores.tail) continue;
+    uint64_t mismatches = overlap & ~matches;
+    if (tail_b && len_b + shift <= len_a) {
+      scores.tail = TailMatches(mismatches & tail_b_mask, tail_b_end);
+    }
+    if (shift == 0 && tail_len <= std::min(len_a, len_b)) {
+      scores.tail |= TailMatches(mismatches & tail_a_mask, 1);
+    }
+  }
+  // b shifted down: bit p compares base p of a with base p + shift of b
+  for (unsigned shift = 1;
+      shift < len_b && len_b - shift > std::min(scores.lcs_len, least - 1);
+      ++shift) {
+    uint64_t overlap = valid_a & (valid_b >> shift);
+    uint64_t matches = ~((a_lo ^ (b_lo >> shift)) | (a_hi ^ (b_hi >> shift)))
+        & overlap;
+    if (RunStarts(matches, scores.lcs_len + 1)) {
+      UpdateLongestRun(matches, &scores.lcs_len);
+    }
+    if (j_ > 0) found |= RunStarts(matches, j_);
+    if (scores.tail) continue;
+    // the mismatches are in the frame of a, so the tail of b is shifted
+    // back into its own
+    uint64_t mismatches = overlap & ~matches;
+    unsigned end_b = len_b - shift;
+    if (tail_b && end_b >= tail_len && end_b <= len_a) {
+      scores.tail = TailMatches((mismatches << shift) & tail_b_mask,
+          tail_b_end);
+    }
+    if (tail_len <= std::min(len_a, end_b)) {
+      scores.tail |= TailMatches(mismatches & tail_a_mask, 1);
+    }
+  }
+  scores.jmers = __builtin_popcountll(found & counted_[counted_offsets_[a]]);
+  return scores;
+}
+
+PairScores PairKernel::ScoreScan(unsigned a, unsigned b) const {
+  const unsigned len_a = primers_.Length(a), len_b = primers_.Length(b);
+  const unsigned tail_len = tail_len_;
+  const uint64_t* counted = &counted_[counted_offsets_[a]];
+  PairScores scores = {false, 0, 0};
+  std::vector<bool> found(len_a, false);
+  std::vector<bool> matches;
+  // diagonal d compares base p + d of a with base p of b, d from
+  // -(len_b - 1) to len_a - 1
+  for (int d = 1 - static_cast<int>(len_b); d < static_cast<int>(len_a);
+      ++d) {
+    unsigned first = d < 0 ? -d : 0;
+    unsigned last = std::min<int>(len_b, len_a - d);
+    matches.assign(len_b, false);
+    unsigned run = 0;
+    for (unsigned p = first; p < last; ++p) {
+      matches[p] = primers_.RcBase(a, p + d) == primers_.Base(b, p);
+      run = matches[p] ? run + 1 : 0;
+      scores.lcs_len = std::max(scores.lcs_len, run);
+      if (j_ > 0 && run >= j_) found[p + 1 - j_ + d] = true;
+    }
+    // the mismatches over the tail_len bases of b from start, at most
+    // max_mismatches with the base at end_base matching
+    auto tail_matches = [&](unsigned start, unsigned end_base) {
+      if (!matches[end_base]) return false;
+      unsigned mismatches = 0;
+      for (unsigned p = start; p < start + tail_len; ++p) {
+        if (!matches[p]) ++mismatches;
+      }
+      return mismatches <= max_mismatches_;
+    };
+    if (tail_len > 0 && len_b >= tail_len && len_b - tail_len >= first
+        && len_b <= last) {
+      scores.tail |= tail_matches(len_b - tail_len, len_b - 1);
+    }
+    if (tail_len > 0 && d <= 0 && first + tail_len <= last) {
+      scores.tail |= tail_matches(first, first);
+    }
+  }
+  for (unsigned p = 0; p < len_a; ++p) {
+    if (found[p] && (counted[p / 64] >> (p % 64) & 1)) ++scores.jmers;
+  }
+  return scores;
+}
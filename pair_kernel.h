@@ -0,0 +1,74 @@
+#ifndef PAIR_KERNEL_H
+#define PAIR_KERNEL_H
+
+#include <stdint.h>     // for uint64_t
+
+#include <vector>       // for std::vector
+
+#include "primer_panel.h"
+
+// The scores of one pair under all three tests of main.
+struct PairScores {
+  // whether the 3' tail of either primer matches a window of the other, as
+  // MatchTails finds
+  bool tail;
+  // the shared j-mers, as JmerCounter::Count gives them
+  unsigned jmers;
+  // the longest common substring, as LcsLen gives it
+  unsigned lcs_len;
+};
+
+// Scores a pair for the tail, j-mer and lcs tests together, in one sweep
+// over the diagonals of rc(primer min(i, k)) against primer max(i, k)
+// instead of three passes over unrelated tables. On each diagonal the
+// bases that agree form a match mask: its longest run is a common
+// substring, its runs of j bases or more start the j-mers of the reverse
+// complement found in the other primer, and its mismatches at either end
+// of the pair decide the tail test in both directions.
+//
+// Pairs of primers of up to 64 bases are swept on their packed planes, one
+// diagonal per xor, with both primers held in four words; longer primers
+// fall back to a base-by-base scan of the same diagonals. This is for
+// dense statistics over every pair of a sample, where all three scores are
+// wanted; the filter pipeline never scores a pair that fails a cheaper
+// test.
+class PairKernel {
+ public:
+  PairKernel(const PrimerPanel &primers, unsigned tail_len,
+      unsigned max_mismatches, unsigned j, bool coarse);
+
+  PairScores Score(unsigned i, unsigned k) const;
+  // Sets scores[t] to Score(i, partners[t]) for t < count; the partners
+  // after i are scored four at a time where the cpu has AVX2.
+  void ScoreBatch(unsigned i, const unsigned* partners, unsigned count,
+      PairScores* scores) const;
+  // the fewest mismatches of any alignment the tail test tries for the
+  // pair, which passes it when they are at most max_mismatches; tail_len
+  // + 1 when no alignment has the 3' end of the tail matched
+  unsigned TailMismatches(unsigned i, unsigned k) const;
+
+ private:
+  // a is the primer scored by its reverse complement, b the other one
+  PairScores ScorePacked(unsigned a, unsigned b) const;
+  PairScores ScoreScan(unsigned a, unsigned b) const;
+  // whether the mismatch mask over a tail, whose 3' end is at the bit
+  // end_bit, passes
+  bool TailMatches(uint64_t mismatches, uint64_t end_bit) const {
+    return (mismatches & end_bit) == 0
+        && static_cast<unsigned>(__builtin_popcountll(mismatches))
+            <= max_mismatches_;
+  }
+
+  const PrimerPanel &primers_;
+  unsigned tail_len_;
+  unsigned max_mismatches_;
+  unsigned j_;
+  // for every primer, the positions of its reverse complement which start
+  // a j-mer that Count counts: the first of each distinct j-mer, among
+  // every j-th from the 5' end when coarse; counted_offsets_[i] is the
+  // first word of primer i
+  std::vector<uint64_t> counted_;
+  std::vector<unsigned> counted_offsets_;
+};
+
+#endif
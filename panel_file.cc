@@ -0,0 +1,179 @@
+#include "panel_file.h"
+
+#include <errno.h>      // for errno, ERANGE
+#include <fcntl.h>      // for open()
+#include <limits.h>     // for UINT_MAX
+#include <stdint.h>     // for uint8_t
+#include <stdlib.h>     // for strtoul()
+#include <string.h>     // for memchr()
+#include <sys/mman.h>   // for mmap(), munmap()
+#include <sys/stat.h>   // for fstat()
+#include <unistd.h>     // for close()
+
+#include <algorithm>    // for std::min
+#include <vector>       // for std::vector
+
+namespace {
+
+// a run of characters in the mapped file
+struct Field {
+  const char* data;
+  size_t size;
+};
+
+// Cuts the mapped file into lines, without their line endings.
+class LineReader {
+ public:
+  LineReader(const char* data, size_t size)
+      : next_(data), end_(data + size) {}
+
+  bool Next(Field* line) {
+    if (next_ == end_) return false;
+    const char* newline = static_cast<const char*>(
+        memchr(next_, '\n', end_ - next_));
+    const char* line_end = newline != nullptr ? newline : end_;
+    line->data = next_;
+    line->size = line_end - next_;
+    while (line->size > 0 && (line->data[line->size - 1] == '\r'
+        || line->data[line->size - 1] == ' ')) {
+      --line->size;
+    }
+    next_ = newline != nullptr ? newline + 1 : end_;
+    ++line_number_;
+    return true;
+  }
+  unsigned LineNumber() const {
+    return line_number_;
+  }
+
+ private:
+  const char* next_;
+  const char* end_;
+  unsigned line_number_ = 0;
+};
+
+// the field of line up to its first comma at or after from
+Field CsvField(const Field &line, size_t from) {
+  const char* start = line.data + from;
+  const char* comma = static_cast<const char*>(
+      memchr(start, ',', line.size - from));
+  return {start, static_cast<size_t>(
+      (comma != nullptr ? comma : line.data + line.size) - start)};
+}
+
+bool IsCount(const Field &line) {
+  if (line.size == 0) return false;
+  for (size_t c = 0; c < line.size; ++c) {
+    if (line.data[c] < '0' || line.data[c] > '9') return false;
+  }
+  return true;
+}
+
+// encodes sequence into codes and appends it to primers; an empty sequence
+// is as invalid as one with a base other than ACGT
+bool AppendPrimer(const Field &name, const Field &sequence,
+    std::vector<uint8_t>* codes, PrimerPanel* primers, std::string* error) {
+  if (codes->size() < sequence.size) codes->resize(sequence.size);
+  if (sequence.size == 0
+      || !EncodeBases(sequence.data, sequence.size, codes->data())) {
+    *error = "Invalid sequence:\nprimer name = "
+        + std::string(name.data, name.size) + "\nsequence = "
+        + std::string(sequence.data, sequence.size);
+    return false;
+  }
+  primers->Append(name.data, name.size, codes->data(), sequence.size);
+  return true;
+}
+
+bool ParseCsv(const char* data, size_t size, PrimerPanel* primers,
+    std::string* error) {
+  // every line holds at most one primer, so the file size bounds the bases
+  // and the name bytes
+  LineReader lines(data, size);
+  Field line = {nullptr, 0};
+  unsigned number_of_lines = 0;
+  while (lines.Next(&line)) ++number_of_lines;
+  primers->Reserve(number_of_lines, size, size);
+  lines = LineReader(data, size);
+  std::vector<uint8_t> codes;
+  while (lines.Next(&line)) {
+    if (line.size == 0) continue;
+    Field name = CsvField(line, 0);
+    if (name.size == line.size) {
+      *error = "Line " + std::to_string(lines.LineNumber())
+          + " of the input file has no sequence.";
+      return false;
+    }
+    Field sequence = CsvField(line, name.size + 1);
+    if (!AppendPrimer(name, sequence, &codes, primers, error)) return false;
+  }
+  return true;
+}
+
+bool ParseCounted(const char* data, size_t size, PrimerPanel* primers,
+    std::string* error) {
+  LineReader lines(data, size);
+  Field line = {nullptr, 0};
+  lines.Next(&line);
+  // the line is all digits, but may be too large a number
+  std::string count(line.data, line.size);
+  char* end = nullptr;
+  errno = 0;
+  unsigned long number = strtoul(count.c_str(), &end, 10);
+  if (errno == ERANGE || *end != '\0' || end == count.c_str()
+      || number > UINT_MAX) {
+    *error = "Invalid primer count: " + count;
+    return false;
+  }
+  unsigned number_of_primers = number;
+  // a primer takes a line, so the file size bounds a false count
+  primers->Reserve(std::min<size_t>(number_of_primers, size), size);
+  std::vector<uint8_t> codes;
+  while (primers->size() < number_of_primers && lines.Next(&line)) {
+    if (line.size == 0) continue;
+    std::string name = std::to_string(primers->size() + 1);
+    if (!AppendPrimer({name.data(), name.size()}, line, &codes, primers,
+        error)) {
+      return false;
+    }
+  }
+  if (primers->size() < number_of_primers) {
+    *error = "The input file holds " + std::to_string(primers->size())
+        + " of its " + std::to_string(number_of_primers) + " primers.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadPanelFile(const std::string &file_name, PrimerPanel* primers,
+    std::string* error) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    if (fd >= 0) close(fd);
+    *error = "Could not open input file.";
+    return false;
+  }
+  size_t size = status.st_size;
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+      fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    *error = "Could not map input file.";
+    return false;
+  }
+  const char* data = static_cast<const char*>(mapping);
+  LineReader lines(data, size);
+  Field first_line = {nullptr, 0};
+  lines.Next(&first_line);
+  bool ok = IsCount(first_line) ? ParseCounted(data, size, primers, error)
+      : ParseCsv(data, size, primers, error);
+  munmap(mapping, size);
+  return ok;
+}
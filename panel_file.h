@@ -0,0 +1,25 @@
+#ifndef PANEL_FILE_H
+#define PANEL_FILE_H
+
+#include <string>       // for std::string
+
+#include "primer_panel.h"
+
+// Reads the primers of a panel file into primers, which is either
+//
+//   a CSV file whose lines hold the name and sequence of a primer in their
+//   first two fields, with any further fields ignored, as in data/data.txt
+//
+//   a count of primers on the first line followed by one sequence per line,
+//   as in data/test_data_*.txt, whose primers are named by their number
+//   counting from 1
+//
+// The file is mapped read-only and parsed in place: fields are views into
+// the mapping until they are packed, and every sequence is validated and
+// encoded in one pass. Bases may be upper or lower case. Returns false with
+// a message in error if the file cannot be read or holds an invalid
+// sequence.
+bool ReadPanelFile(const std::string &file_name, PrimerPanel* primers,
+    std::string* error);
+
+#endif
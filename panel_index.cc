@@ -0,0 +1,34 @@
+#include "panel_index.h"
+
+bool WritePanelIndex(const std::string &file_name, const PrimerPanel &primers,
+    const TailMatcher &matcher, TailIndex tail_index,
+    const JmerCounter &counter, unsigned j, bool coarse) {
+  IndexFileHeader header = IndexFileHeader();
+  header.tail_len = matcher.TailLength();
+  header.max_mismatches = matcher.MaxMismatches();
+  header.tail_index = tail_index;
+  header.j = j;
+  header.coarse = coarse;
+  IndexWriter writer;
+  primers.Save(&writer);
+  matcher.Save(&writer);
+  counter.Save(&writer);
+  return writer.Save(file_name, header);
+}
+
+bool PanelIndex::Open(const std::string &file_name, std::string* error) {
+  if (!reader_.Open(file_name, error)) return false;
+  primers_.Load(&reader_);
+  matcher_.reset(new TailMatcher(&reader_));
+  counter_.reset(new JmerCounter(&reader_));
+  return true;
+}
+
+bool PanelIndex::BuiltWith(unsigned tail_len, unsigned max_mismatches,
+    TailIndex tail_index, unsigned j, bool coarse) const {
+  const IndexFileHeader &header = reader_.Header();
+  return header.tail_len == tail_len
+      && header.max_mismatches == max_mismatches
+      && header.tail_index == static_cast<uint32_t>(tail_index)
+      && header.j == j && header.coarse == coarse;
+}
@@ -0,0 +1,51 @@
+#ifndef PANEL_INDEX_H
+#define PANEL_INDEX_H
+
+#include <memory>       // for std::unique_ptr
+#include <string>       // for std::string
+
+#include "index_file.h"
+#include "jmer_matching.h"
+#include "primer_panel.h"
+#include "tail_matching.h"
+#include "tail_table.h"
+
+// Writes primers, with the tail matcher and j-mer counter built from them,
+// to an index file whose header records the parameters the tables were
+// built with. Returns false if the file cannot be written.
+bool WritePanelIndex(const std::string &file_name, const PrimerPanel &primers,
+    const TailMatcher &matcher, TailIndex tail_index,
+    const JmerCounter &counter, unsigned j, bool coarse);
+
+// A panel index file mapped read-only. The panel and tables view the
+// mapping directly, so opening the file costs little more than checking its
+// checksum and the pages are shared by every process using the file.
+class PanelIndex {
+ public:
+  // returns false with a message in error if the file is not a valid index
+  bool Open(const std::string &file_name, std::string* error);
+  bool IsOpen() const {
+    return matcher_ != nullptr;
+  }
+  // whether the tables were built with these parameters
+  bool BuiltWith(unsigned tail_len, unsigned max_mismatches,
+      TailIndex tail_index, unsigned j, bool coarse) const;
+
+  const PrimerPanel &Primers() const {
+    return primers_;
+  }
+  const TailMatcher &Matcher() const {
+    return *matcher_;
+  }
+  const JmerCounter &Counter() const {
+    return *counter_;
+  }
+
+ private:
+  IndexReader reader_;
+  PrimerPanel primers_;
+  std::unique_ptr<TailMatcher> matcher_;
+  std::unique_ptr<JmerCounter> counter_;
+};
+
+#endif
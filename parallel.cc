@@ -0,0 +1,111 @@
+#include "parallel.h"
+
+#include <algorithm>    // for std::min, std::max
+#include <atomic>       // for std::atomic
+#include <deque>        // for std::deque
+#include <mutex>        // for std::mutex, std::lock_guard
+#include <thread>       // for std::thread
+
+namespace {
+
+struct BlockQueue {
+  std::mutex mutex;
+  std::deque<unsigned> blocks;
+};
+
+bool TakeBlock(BlockQueue* queue, bool from_back, unsigned* block) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  if (queue->blocks.empty()) return false;
+  if (from_back) {
+    *block = queue->blocks.back();
+    queue->blocks.pop_back();
+  } else {
+    *block = queue->blocks.front();
+    queue->blocks.pop_front();
+  }
+  return true;
+}
+
+}  // namespace
+
+unsigned ResolveThreads(unsigned threads) {
+  if (threads != 0) return threads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelForBlocks(unsigned number_of_blocks, unsigned threads,
+    const std::function<void(unsigned, unsigned)> &work) {
+  threads = std::min(ResolveThreads(threads), std::max(1u, number_of_blocks));
+  if (threads == 1) {
+    for (unsigned block = 0; block < number_of_blocks; ++block) work(block, 0);
+    return;
+  }
+  std::vector<BlockQueue> queues(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    unsigned first = static_cast<unsigned long long>(number_of_blocks) * t / threads;
+    unsigned last = static_cast<unsigned long long>(number_of_blocks) * (t + 1) / threads;
+    for (unsigned block = first; block < last; ++block) {
+      queues[t].blocks.push_back(block);
+    }
+  }
+  // no blocks are added once the threads start, so a thread which finds
+  // every deque empty is done
+  auto worker = [&](unsigned t) {
+    unsigned block;
+    for (;;) {
+      bool found = TakeBlock(&queues[t], false, &block);
+      for (unsigned v = 1; !found && v < threads; ++v) {
+        found = TakeBlock(&queues[(t + v) % threads], true, &block);
+      }
+      if (!found) return;
+      work(block, t);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) pool.push_back(std::thread(worker, t));
+  worker(0);
+  for (std::thread &thread : pool) thread.join();
+}
+
+void ParallelForOrderedBlocks(unsigned number_of_blocks, unsigned threads,
+    const std::function<void(unsigned, unsigned)> &work) {
+  threads = std::min(ResolveThreads(threads), std::max(1u, number_of_blocks));
+  std::atomic<unsigned> next(0);
+  auto worker = [&](unsigned t) {
+    for (unsigned block = next++; block < number_of_blocks; block = next++) {
+      work(block, t);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) pool.push_back(std::thread(worker, t));
+  worker(0);
+  for (std::thread &thread : pool) thread.join();
+}
+
+std::vector<unsigned> TriangleRowBlocks(unsigned n, unsigned number_of_blocks) {
+  std::vector<unsigned> firsts(1, 0);
+  if (n == 0) return firsts;
+  number_of_blocks = std::max(1u, std::min(number_of_blocks, n));
+  unsigned long long total = static_cast<unsigned long long>(n) * (n + 1) / 2;
+  unsigned long long done = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    done += n - i;
+    // close the block once it reaches its share of the pairs
+    if (firsts.size() < number_of_blocks &&
+        done * number_of_blocks >= total * firsts.size() && i + 1 < n) {
+      firsts.push_back(i + 1);
+    }
+  }
+  firsts.push_back(n);
+  return firsts;
+}
+
+std::vector<unsigned> UniformRowBlocks(unsigned n, unsigned number_of_blocks) {
+  number_of_blocks = std::max(1u, std::min(number_of_blocks, n));
+  std::vector<unsigned> firsts;
+  for (unsigned b = 0; b < number_of_blocks; ++b) {
+    firsts.push_back(static_cast<unsigned long long>(n) * b / number_of_blocks);
+  }
+  firsts.push_back(n);
+  return firsts;
+}
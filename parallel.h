@@ -0,0 +1,36 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>   // for std::function
+#include <vector>       // for std::vector
+
+// the number of threads to use when asked for threads, where 0 means one
+// per hardware thread
+unsigned ResolveThreads(unsigned threads);
+
+// Calls work(block, thread) once for every block in [0, number_of_blocks)
+// using up to threads threads, with thread in [0, threads). Each thread
+// starts with a contiguous share of the blocks in a deque of its own, takes
+// blocks from the front of it, and once it runs dry steals from the back of
+// the other threads' deques, so uneven blocks do not leave threads idle.
+// Blocks may run in any order; callers keep their output in per-block
+// buffers and merge them in block order to stay deterministic.
+void ParallelForBlocks(unsigned number_of_blocks, unsigned threads,
+    const std::function<void(unsigned, unsigned)> &work);
+
+// Calls work(block, thread) as ParallelForBlocks does, but hands the blocks
+// out in increasing order from a single counter, so blocks finish roughly
+// in order for callers which consume them in order as they finish.
+void ParallelForOrderedBlocks(unsigned number_of_blocks, unsigned threads,
+    const std::function<void(unsigned, unsigned)> &work);
+
+// Splits the rows [0, n) of the upper triangle of an n x n pair space, where
+// row i holds the n - i pairs (i, k >= i), into at most number_of_blocks
+// runs of consecutive rows with roughly equal numbers of pairs. Returns the
+// first row of each block followed by n.
+std::vector<unsigned> TriangleRowBlocks(unsigned n, unsigned number_of_blocks);
+
+// as TriangleRowBlocks, for rows which all hold the same number of pairs
+std::vector<unsigned> UniformRowBlocks(unsigned n, unsigned number_of_blocks);
+
+#endif
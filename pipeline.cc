@@ -0,0 +1,290 @@
+#include "pipeline.h"
+
+#include <algorithm>    // for std::lower_bound, std::min, std::upper_bound
+#include <chrono>       // for std::chrono::steady_clock
+#include <limits>       // for std::numeric_limits
+#include <mutex>        // for std::mutex, std::unique_lock
+#include <utility>      // for std::move
+
+#include "lcs.h"
+#include "parallel.h"
+
+namespace {
+
+// the partner data of a tile is kept to a typical L2 cache
+const size_t tile_bytes = 256 * 1024;
+// but tiles are never so small that filtering a row is all overhead
+const unsigned min_tile_side = 64;
+
+// the first candidate of row with a partner of at least k
+template <typename Iterator>
+Iterator FirstPartner(Iterator first, Iterator last, unsigned k) {
+  return std::lower_bound(first, last, k,
+      [](const Candidate &candidate, unsigned partner) {
+        return candidate.partner < partner;
+      });
+}
+
+}  // namespace
+
+FilterPipeline::FilterPipeline(unsigned number_of_primers)
+    : number_of_primers_(number_of_primers) {}
+
+void FilterPipeline::AddStage(std::unique_ptr<PairStage> stage) {
+  // keep the stages in order of cost, ties in the order they were added
+  auto it = std::upper_bound(stages_.begin(), stages_.end(), stage,
+      [](const std::unique_ptr<PairStage> &a,
+          const std::unique_ptr<PairStage> &b) {
+        return a->Cost() < b->Cost();
+      });
+  statistics_.insert(statistics_.begin() + (it - stages_.begin()),
+      StageStatistics());
+  stages_.insert(it, std::move(stage));
+}
+
+void FilterPipeline::VisitRows(const RowVisitor &visit, unsigned threads) {
+  // threads take row blocks of equal numbers of upper triangle pairs, in
+  // order, and work through each in tiles
+  threads = ResolveThreads(threads);
+  unsigned side = TileSide();
+  std::vector<unsigned> firsts = TriangleRowBlocks(number_of_primers_,
+      16 * threads);
+  std::vector<std::vector<StageStatistics>> thread_statistics(threads,
+      std::vector<StageStatistics>(stages_.size()));
+  // finished blocks wait until the blocks before them are visited
+  std::mutex mutex;
+  std::vector<CandidatePairs> blocks(firsts.size() - 1);
+  std::vector<bool> finished(blocks.size(), false);
+  unsigned next = 0;
+  bool visiting = false;
+  ParallelForOrderedBlocks(blocks.size(), threads,
+      [&](unsigned b, unsigned t) {
+    CandidatePairs block;
+    std::vector<std::vector<Candidate>> survivors;
+    for (unsigned first = firsts[b]; first < firsts[b + 1]; first += side) {
+      unsigned last = std::min(first + side, firsts[b + 1]);
+      survivors.assign(last - first, std::vector<Candidate>());
+      RunTiles(first, last, side,
+          [&](unsigned i, const std::vector<Candidate> &row) {
+            std::vector<Candidate> &kept = survivors[i - first];
+            kept.insert(kept.end(), row.begin(), row.end());
+          },
+          &thread_statistics[t]);
+      for (const std::vector<Candidate> &row : survivors) {
+        block.AppendRow(row);
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    blocks[b] = std::move(block);
+    finished[b] = true;
+    if (visiting) return;
+    // visit every block now ready, without the lock, so other threads can
+    // hand theirs over meanwhile
+    visiting = true;
+    while (next < blocks.size() && finished[next]) {
+      CandidatePairs rows = std::move(blocks[next]);
+      unsigned first = firsts[next++];
+      lock.unlock();
+      for (unsigned r = 0; r < rows.Rows(); ++r) {
+        visit(first + r, rows[r].begin(), rows[r].end());
+      }
+      lock.lock();
+    }
+    visiting = false;
+  });
+  AddStatistics(thread_statistics);
+}
+
+void FilterPipeline::Visit(const Visitor &visit, unsigned threads) {
+  threads = ResolveThreads(threads);
+  unsigned side = TileSide();
+  std::vector<unsigned> firsts = TriangleRowBlocks(number_of_primers_,
+      16 * threads);
+  std::vector<std::vector<StageStatistics>> thread_statistics(threads,
+      std::vector<StageStatistics>(stages_.size()));
+  ParallelForBlocks(firsts.size() - 1, threads, [&](unsigned b, unsigned t) {
+    for (unsigned first = firsts[b]; first < firsts[b + 1]; first += side) {
+      unsigned last = std::min(first + side, firsts[b + 1]);
+      RunTiles(first, last, side,
+          [&](unsigned i, const std::vector<Candidate> &row) {
+            visit(i, row, t);
+          },
+          &thread_statistics[t]);
+    }
+  });
+  AddStatistics(thread_statistics);
+}
+
+void FilterPipeline::AddStatistics(
+    const std::vector<std::vector<StageStatistics>> &thread_statistics) {
+  for (const std::vector<StageStatistics> &statistics : thread_statistics) {
+    for (unsigned s = 0; s < stages_.size(); ++s) {
+      statistics_[s].pairs_in += statistics[s].pairs_in;
+      statistics_[s].pairs_out += statistics[s].pairs_out;
+      statistics_[s].seconds += statistics[s].seconds;
+    }
+  }
+}
+
+unsigned FilterPipeline::TileSide() const {
+  size_t bytes = 0;
+  for (const std::unique_ptr<PairStage> &stage : stages_) {
+    bytes += stage->PartnerBytes();
+  }
+  if (bytes == 0) return std::max(number_of_primers_, 1u);
+  return std::max<size_t>(tile_bytes / bytes, min_tile_side);
+}
+
+void FilterPipeline::RunTiles(unsigned first, unsigned last, unsigned side,
+    const std::function<void(unsigned, const std::vector<Candidate> &)>
+        &visit,
+    std::vector<StageStatistics>* statistics) const {
+  unsigned rows = last - first;
+  // the first stage seeds each row once, from the diagonal on; without a
+  // seed a tile starts from all its pairs
+  std::vector<std::vector<Candidate>> seeds(rows);
+  std::vector<unsigned> next(rows, 0);
+  bool seeded = false;
+  if (!stages_.empty()) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < rows; ++r) {
+      unsigned i = first + r;
+      std::vector<Candidate> &seed = seeds[r];
+      seeded = stages_[0]->Seed(i, &seed);
+      seed.erase(seed.begin(), FirstPartner(seed.begin(), seed.end(), i));
+      (*statistics)[0].pairs_in += number_of_primers_ - i;
+    }
+    (*statistics)[0].seconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::vector<std::vector<Candidate>> tile(rows);
+  for (unsigned column = first; column < number_of_primers_;
+      column += side) {
+    unsigned end = std::min(column + side, number_of_primers_);
+    for (unsigned r = 0; r < rows; ++r) {
+      unsigned i = first + r;
+      std::vector<Candidate> &row = tile[r];
+      row.clear();
+      if (seeded) {
+        const std::vector<Candidate> &seed = seeds[r];
+        while (next[r] < seed.size() && seed[next[r]].partner < end) {
+          row.push_back(seed[next[r]++]);
+        }
+      } else {
+        for (unsigned k = std::max(column, i); k < end; ++k) {
+          row.push_back({k, 0, 0});
+        }
+      }
+    }
+    for (unsigned s = 0; s < stages_.size(); ++s) {
+      auto start = std::chrono::steady_clock::now();
+      StageStatistics &stage_statistics = (*statistics)[s];
+      for (unsigned r = 0; r < rows; ++r) {
+        std::vector<Candidate> &row = tile[r];
+        if (s > 0) stage_statistics.pairs_in += row.size();
+        if (!row.empty() && (s > 0 || !seeded)) {
+          stages_[s]->Filter(first + r, &row);
+        }
+        stage_statistics.pairs_out += row.size();
+      }
+      stage_statistics.seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+    }
+    for (unsigned r = 0; r < rows; ++r) {
+      if (!tile[r].empty()) visit(first + r, tile[r]);
+    }
+  }
+}
+
+void FilterPipeline::PrintStatistics(std::ostream &out) const {
+  out << "========================================\n";
+  out << "Filter pipeline ========================\n";
+  out << "========================================\n";
+  for (unsigned s = 0; s < stages_.size(); ++s) {
+    const StageStatistics &statistics = statistics_[s];
+    out << stages_[s]->Name() << ": pairs tested = " << statistics.pairs_in
+        << ", pairs passed = " << statistics.pairs_out
+        << ", proportion passed = "
+        << (statistics.pairs_in ?
+            (double)statistics.pairs_out / statistics.pairs_in : 0)
+        << ", seconds = " << statistics.seconds << '\n';
+  }
+  out << "========================================\n";
+}
+
+void FilterPipeline::RecordMetrics(Metrics* metrics) const {
+  for (unsigned s = 0; s < stages_.size(); ++s) {
+    const std::string name = stages_[s]->Name();
+    metrics->Count(name + "_pairs_tested", statistics_[s].pairs_in);
+    metrics->Count(name + "_pairs_passed", statistics_[s].pairs_out);
+    metrics->Seconds(name + "_thread_seconds", statistics_[s].seconds);
+  }
+}
+
+bool TailStage::Seed(unsigned i, std::vector<Candidate>* row) const {
+  row->assign(tail_hits_[i].begin(), tail_hits_[i].end());
+  return true;
+}
+
+void TailStage::Filter(unsigned i, std::vector<Candidate>* row) const {
+  // both rows are in order of partner, so intersect them in one merge from
+  // the first partner of row
+  if (row->empty()) return;
+  const Candidate* end = tail_hits_[i].end();
+  const Candidate* hit = FirstPartner(tail_hits_[i].begin(), end,
+      row->front().partner);
+  unsigned kept = 0;
+  for (const Candidate &candidate : *row) {
+    while (hit != end && hit->partner < candidate.partner) ++hit;
+    if (hit == end) break;
+    if (hit->partner == candidate.partner) (*row)[kept++] = candidate;
+  }
+  row->resize(kept);
+}
+
+void JmerStage::Filter(unsigned i, std::vector<Candidate>* row) const {
+  counter_.CountRow(i, row);
+  unsigned kept = 0;
+  for (const Candidate &candidate : *row) {
+    if (candidate.jmers >= minimum_matching_jmers_) (*row)[kept++] = candidate;
+  }
+  row->resize(kept);
+}
+
+void LcsStage::Filter(unsigned i, std::vector<Candidate>* row) const {
+  std::vector<unsigned> partners(row->size());
+  std::vector<unsigned> lcs_lens(row->size());
+  for (unsigned t = 0; t < row->size(); ++t) partners[t] = (*row)[t].partner;
+  LcsLenBatch(primers_, i, partners.data(), partners.size(), lcs_lens.data());
+  unsigned kept = 0;
+  for (unsigned t = 0; t < row->size(); ++t) {
+    if (lcs_lens[t] < minimum_lcs_threshold_) continue;
+    (*row)[kept] = (*row)[t];
+    (*row)[kept++].lcs_len = lcs_lens[t];
+  }
+  row->resize(kept);
+}
+
+bool LcsJoinStage::Seed(unsigned i, std::vector<Candidate>* row) const {
+  join_.Row(i, i, std::numeric_limits<unsigned>::max(), row);
+  return true;
+}
+
+void LcsJoinStage::Filter(unsigned i, std::vector<Candidate>* row) const {
+  // both rows are in order of partner, so intersect them in one merge
+  if (row->empty()) return;
+  std::vector<Candidate> passed;
+  join_.Row(i, row->front().partner, row->back().partner + 1, &passed);
+  unsigned kept = 0;
+  unsigned p = 0;
+  for (const Candidate &candidate : *row) {
+    while (p < passed.size() && passed[p].partner < candidate.partner) ++p;
+    if (p == passed.size()) break;
+    if (passed[p].partner != candidate.partner) continue;
+    (*row)[kept] = candidate;
+    if (join_.ExactLengths()) (*row)[kept].lcs_len = passed[p].lcs_len;
+    ++kept;
+  }
+  row->resize(kept);
+}
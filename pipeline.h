@@ -0,0 +1,174 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>     // for size_t
+#include <stdint.h>     // for uint64_t
+
+#include <functional>   // for std::function
+#include <iostream>     // for std::ostream
+#include <memory>       // for std::unique_ptr
+#include <string>       // for std::string
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "jmer_matching.h"
+#include "lcs_join.h"
+#include "metrics.h"
+#include "primer_panel.h"
+
+// One filter of the pipeline. A stage is given the candidates of one row
+// which survived every cheaper stage, in increasing order of partner, and
+// removes those failing its own test, recording any score it computes in
+// the survivors. Every test must be symmetric in the two primers of a pair.
+class PairStage {
+ public:
+  virtual ~PairStage() {}
+  virtual std::string Name() const = 0;
+  // the relative cost of testing one pair; stages run cheapest first
+  virtual double Cost() const = 0;
+  // A stage which can list its survivors in row i directly writes them to
+  // row and returns true. Otherwise the pipeline starts from all partners.
+  virtual bool Seed(unsigned i, std::vector<Candidate>* row) const {
+    return false;
+  }
+  virtual void Filter(unsigned i, std::vector<Candidate>* row) const = 0;
+  // the bytes the stage reads for each partner it tests, which sizes the
+  // tiles of the pair space
+  virtual size_t PartnerBytes() const {
+    return 0;
+  }
+};
+
+// Runs a set of stages over the rows of the pair space in order of cost,
+// each stage seeing only the survivors of the previous one, so no pair is
+// tested by an expensive stage unless it passed all the cheap ones and no
+// score is ever computed twice. Keeps the number of pairs each stage saw
+// and passed and the time it took.
+//
+// Visit and VisitRows test each unordered pair once, in the upper triangle,
+// and hand on the survivors unmirrored. The triangle is cut into square
+// tiles whose partners' data, as given by PartnerBytes, fits in the L2
+// cache, and every stage filters all the rows of a tile against those
+// partners before the next tile is started, so the cost of a pair does not
+// grow once the panel outgrows the cache.
+class FilterPipeline {
+ public:
+  explicit FilterPipeline(unsigned number_of_primers);
+
+  void AddStage(std::unique_ptr<PairStage> stage);
+  // Runs every tile on threads threads (0 for one per core), handing the
+  // survivors of each row of each tile to visit(i, row, thread): row holds
+  // partners k >= i of one tile in increasing order, each pair standing
+  // for both (i, k) and (k, i). Rows and tiles come in no particular
+  // order, and thread in [0, threads) is the thread calling. Stage times
+  // are summed over the threads, and the pairs each stage saw count each
+  // pair (i, k) once.
+  typedef std::function<void(unsigned, const std::vector<Candidate> &,
+      unsigned)> Visitor;
+  void Visit(const Visitor &visit, unsigned threads);
+  // Runs every tile as Visit does, handing the survivors of each row i, its
+  // partners [first, last) with k >= i in increasing order, to
+  // visit(i, first, last) once for every i in increasing order. Blocks of
+  // rows are visited as soon as the blocks before them are, from the thread
+  // which finished them, while the other threads go on filtering; the calls
+  // never overlap.
+  typedef std::function<void(unsigned, const Candidate*, const Candidate*)>
+      RowVisitor;
+  void VisitRows(const RowVisitor &visit, unsigned threads);
+  void PrintStatistics(std::ostream &out) const;
+  // adds the pairs each stage tested and passed, and its time summed over
+  // the threads, to the counts of the current stage of metrics
+  void RecordMetrics(Metrics* metrics) const;
+
+ private:
+  struct StageStatistics {
+    unsigned long long pairs_in = 0;
+    unsigned long long pairs_out = 0;
+    double seconds = 0;
+  };
+
+  // the rows and columns of a tile
+  unsigned TileSide() const;
+  // hands the survivors of the upper triangle rows first to last - 1 to
+  // visit(i, row), a tile of side columns at a time
+  void RunTiles(unsigned first, unsigned last, unsigned side,
+      const std::function<void(unsigned, const std::vector<Candidate> &)>
+          &visit,
+      std::vector<StageStatistics>* statistics) const;
+  // adds the statistics of every thread to statistics_
+  void AddStatistics(
+      const std::vector<std::vector<StageStatistics>> &thread_statistics);
+
+  unsigned number_of_primers_;
+  std::vector<std::unique_ptr<PairStage>> stages_;
+  std::vector<StageStatistics> statistics_;
+};
+
+// keeps the pairs whose 3' tails match, as found by MatchTails; the hits
+// need only hold the upper triangle
+class TailStage : public PairStage {
+ public:
+  explicit TailStage(const CandidatePairs &tail_hits)
+      : tail_hits_(tail_hits) {}
+  std::string Name() const override { return "tail"; }
+  double Cost() const override { return 1; }
+  bool Seed(unsigned i, std::vector<Candidate>* row) const override;
+  void Filter(unsigned i, std::vector<Candidate>* row) const override;
+
+ private:
+  const CandidatePairs &tail_hits_;
+};
+
+// keeps the pairs sharing at least minimum_matching_jmers j-mers
+class JmerStage : public PairStage {
+ public:
+  JmerStage(const JmerCounter &counter, unsigned minimum_matching_jmers)
+      : counter_(counter), minimum_matching_jmers_(minimum_matching_jmers) {}
+  std::string Name() const override { return "jmer"; }
+  double Cost() const override { return 4; }
+  void Filter(unsigned i, std::vector<Candidate>* row) const override;
+  size_t PartnerBytes() const override { return counter_.BytesPerPrimer(); }
+
+ private:
+  const JmerCounter &counter_;
+  unsigned minimum_matching_jmers_;
+};
+
+// keeps the pairs whose longest common substring is at least
+// minimum_lcs_threshold, scoring each row with LcsLenBatch; with a
+// threshold of 0 it keeps every pair, only recording its lcs
+class LcsStage : public PairStage {
+ public:
+  LcsStage(const PrimerPanel &primers, unsigned minimum_lcs_threshold)
+      : primers_(primers), minimum_lcs_threshold_(minimum_lcs_threshold) {}
+  std::string Name() const override {
+    return minimum_lcs_threshold_ > 0 ? "lcs" : "lcs_len";
+  }
+  double Cost() const override { return 16; }
+  void Filter(unsigned i, std::vector<Candidate>* row) const override;
+  size_t PartnerBytes() const override {
+    // the two bit planes of every block of 64 bases
+    return 2 * sizeof(uint64_t) * ((primers_.MaxLength() + 63) / 64);
+  }
+
+ private:
+  const PrimerPanel &primers_;
+  unsigned minimum_lcs_threshold_;
+};
+
+// keeps the pairs whose longest common substring is at least the join's
+// minimum, taking each row from the join rather than scoring its pairs, so
+// it is cheap enough to seed the rows
+class LcsJoinStage : public PairStage {
+ public:
+  explicit LcsJoinStage(const LcsJoin &join) : join_(join) {}
+  std::string Name() const override { return "lcs"; }
+  double Cost() const override { return 0.5; }
+  bool Seed(unsigned i, std::vector<Candidate>* row) const override;
+  void Filter(unsigned i, std::vector<Candidate>* row) const override;
+
+ private:
+  const LcsJoin &join_;
+};
+
+#endif
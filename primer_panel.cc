@@ -0,0 +1,287 @@
+#include "primer_panel.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>  // for AVX2 intrinsics
+#endif
+
+#include <algorithm>    // for std::copy, std::fill
+#include <vector>       // for std::vector
+
+#include "index_file.h"
+
+namespace {
+
+// Upper and lower case bases map onto their codes by bits 1 and 2 of their
+// ASCII values: A = 0x41, T = 0x54, C = 0x43 and G = 0x47.
+inline uint8_t BaseBits(uint8_t c) {
+  return (c & 2) | ((c >> 2) & 1);
+}
+
+inline bool IsBase(uint8_t c) {
+  c &= 0xdf;
+  return c == 'A' || c == 'T' || c == 'C' || c == 'G';
+}
+
+bool EncodeBasesGeneric(const char* bases, unsigned len, uint8_t* codes) {
+  bool valid = true;
+  for (unsigned pos = 0; pos < len; ++pos) {
+    uint8_t c = bases[pos];
+    valid &= IsBase(c);
+    codes[pos] = BaseBits(c);
+  }
+  return valid;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+bool EncodeBasesAvx2(const char* bases, unsigned len, uint8_t* codes) {
+  const __m256i case_mask = _mm256_set1_epi8(static_cast<char>(0xdf));
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i two = _mm256_set1_epi8(2);
+  __m256i valid = _mm256_set1_epi8(-1);
+  unsigned pos = 0;
+  for (; pos + 32 <= len; pos += 32) {
+    __m256i c = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(bases + pos));
+    __m256i upper = _mm256_and_si256(c, case_mask);
+    __m256i is_base = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(upper, _mm256_set1_epi8('A')),
+            _mm256_cmpeq_epi8(upper, _mm256_set1_epi8('T'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(upper, _mm256_set1_epi8('C')),
+            _mm256_cmpeq_epi8(upper, _mm256_set1_epi8('G'))));
+    valid = _mm256_and_si256(valid, is_base);
+    // the 16-bit shift carries bits across bytes, but the mask drops them
+    __m256i code = _mm256_or_si256(_mm256_and_si256(c, two),
+        _mm256_and_si256(_mm256_srli_epi16(c, 2), one));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + pos), code);
+  }
+  bool all_valid = _mm256_movemask_epi8(valid) == -1;
+  if (pos == len) return all_valid;
+  // encode the last bases through a buffer padded with bases
+  char padded[32];
+  uint8_t padded_codes[32];
+  std::fill(padded, padded + 32, 'A');
+  std::copy(bases + pos, bases + len, padded);
+  bool tail_valid = EncodeBasesAvx2(padded, 32, padded_codes);
+  std::copy(padded_codes, padded_codes + (len - pos), codes + pos);
+  return all_valid && tail_valid;
+}
+#endif
+
+// Packs the len codes at codes, and their reverse complement, into zeroed
+// plane words. Base pos of the reverse complement is the complement of base
+// len - 1 - pos.
+void PackCodesGeneric(const uint8_t* codes, unsigned len, uint64_t* planes,
+    uint64_t* rc_planes) {
+  for (unsigned b = 0; 64 * b < len; ++b) {
+    unsigned block_len = len - 64 * b < 64 ? len - 64 * b : 64;
+    const uint8_t* block_codes = codes + 64 * b;
+    const uint8_t* rc_codes = codes + len - 1 - 64 * b;
+    uint64_t lo = 0, hi = 0, rc_lo = 0, rc_hi = 0;
+    for (unsigned bit = 0; bit < block_len; ++bit) {
+      uint64_t code = block_codes[bit];
+      uint64_t rc_code = rc_codes[-static_cast<int>(bit)] ^ 1;
+      lo |= (code & 1) << bit;
+      hi |= (code >> 1) << bit;
+      rc_lo |= (rc_code & 1) << bit;
+      rc_hi |= (rc_code >> 1) << bit;
+    }
+    planes[2 * b] = lo;
+    planes[2 * b + 1] = hi;
+    rc_planes[2 * b] = rc_lo;
+    rc_planes[2 * b + 1] = rc_hi;
+  }
+}
+
+#if defined(__x86_64__)
+// Packs the 32 codes at codes into the low plane bits words[0] and high
+// plane bits words[1], and the reverse complement of the 32 codes at
+// rc_codes into rc_words, by moving each bit of the codes to the top of its
+// byte and gathering the tops with movemask.
+__attribute__((target("avx2")))
+inline void PackCodesAvx2Block(const uint8_t* codes, const uint8_t* rc_codes,
+    uint64_t* words, uint64_t* rc_words) {
+  const __m256i reverse = _mm256_setr_epi8(
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  __m256i code = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+  // reversed within each lane, then the lanes swapped
+  __m256i rc_code = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(rc_codes));
+  rc_code = _mm256_permute4x64_epi64(
+      _mm256_shuffle_epi8(rc_code, reverse), 0x4e);
+  rc_code = _mm256_xor_si256(rc_code, _mm256_set1_epi8(1));
+  words[0] = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_slli_epi16(code, 7)));
+  words[1] = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_slli_epi16(code, 6)));
+  rc_words[0] = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_slli_epi16(rc_code, 7)));
+  rc_words[1] = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_slli_epi16(rc_code, 6)));
+}
+
+__attribute__((target("avx2")))
+void PackCodesAvx2(const uint8_t* codes, unsigned len, uint64_t* planes,
+    uint64_t* rc_planes) {
+  unsigned pos = 0;
+  for (; pos + 32 <= len; pos += 32) {
+    uint64_t words[2];
+    uint64_t rc_words[2];
+    PackCodesAvx2Block(codes + pos, codes + len - 32 - pos, words, rc_words);
+    uint64_t* block = planes + 2 * (pos / 64);
+    uint64_t* rc_block = rc_planes + 2 * (pos / 64);
+    block[0] |= words[0] << (pos % 64);
+    block[1] |= words[1] << (pos % 64);
+    rc_block[0] |= rc_words[0] << (pos % 64);
+    rc_block[1] |= rc_words[1] << (pos % 64);
+  }
+  if (pos == len) return;
+  // pack the last bases as a whole block of padded codes; the rc bases
+  // pos to len - 1 come from codes 0 to len - 1 - pos
+  alignas(32) uint8_t padded[32] = {0};
+  alignas(32) uint8_t rc_padded[32] = {0};
+  unsigned rest = len - pos;
+  std::copy(codes + pos, codes + len, padded);
+  std::copy(codes, codes + rest, rc_padded + 32 - rest);
+  uint64_t tail[2] = {0, 0};
+  uint64_t rc_tail[2] = {0, 0};
+  PackCodesAvx2Block(padded, rc_padded, tail, rc_tail);
+  uint64_t mask = (1ull << rest) - 1;
+  uint64_t* block = planes + 2 * (pos / 64);
+  uint64_t* rc_block = rc_planes + 2 * (pos / 64);
+  block[0] |= (tail[0] & mask) << (pos % 64);
+  block[1] |= (tail[1] & mask) << (pos % 64);
+  rc_block[0] |= (rc_tail[0] & mask) << (pos % 64);
+  rc_block[1] |= (rc_tail[1] & mask) << (pos % 64);
+}
+
+bool UseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+const bool use_avx2 = UseAvx2();
+#endif
+
+
+}  // namespace
+
+int EncodeBase(char c) {
+  switch (c) {
+    case 'A': return kBaseA;
+    case 'T': return kBaseT;
+    case 'C': return kBaseC;
+    case 'G': return kBaseG;
+    default: return -1;
+  }
+}
+
+char DecodeBase(unsigned code) {
+  static const char bases[number_of_bases] = {'A', 'T', 'C', 'G'};
+  return bases[code & 3];
+}
+
+bool EncodeBases(const char* bases, unsigned len, uint8_t* codes) {
+#if defined(__x86_64__)
+  if (use_avx2) return EncodeBasesAvx2(bases, len, codes);
+#endif
+  return EncodeBasesGeneric(bases, len, codes);
+}
+
+std::string ReverseComplement(const std::string &src) {
+  int len = src.size();
+  std::string ret_str = src;
+  for (int i = 0; i < len; ++i) {
+    ret_str[len - 1 - i] = DecodeBase(EncodeBase(src[i]) ^ 1);
+  }
+  return ret_str;
+}
+
+bool ValidSequence(const std::string &str) {
+  for (char c : str) {
+    if (EncodeBase(c) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PrimerPanel::Reserve(unsigned number_of_primers, unsigned total_bases,
+    unsigned total_name_bytes) {
+  unsigned blocks = number_of_primers + total_bases / 64;
+  planes_.reserve(2 * blocks);
+  rc_planes_.reserve(2 * blocks);
+  block_offsets_.reserve(number_of_primers + 1);
+  lengths_.reserve(number_of_primers);
+  name_offsets_.reserve(number_of_primers + 1);
+  names_.reserve(total_name_bytes);
+}
+
+void PrimerPanel::Append(const std::string &name,
+    const std::string &sequence) {
+  std::vector<uint8_t> codes(sequence.size());
+  for (unsigned pos = 0; pos < sequence.size(); ++pos) {
+    codes[pos] = EncodeBase(sequence[pos]) & 3;
+  }
+  Append(name.data(), name.size(), codes.data(), codes.size());
+}
+
+void PrimerPanel::Append(const char* name, unsigned name_len,
+    const uint8_t* codes, unsigned len) {
+  unsigned blocks = (len + 63) / 64;
+  unsigned first_word = planes_.size();
+  planes_.resize(first_word + 2 * blocks, 0);
+  rc_planes_.resize(first_word + 2 * blocks, 0);
+#if defined(__x86_64__)
+  if (use_avx2) {
+    PackCodesAvx2(codes, len, &planes_[first_word], &rc_planes_[first_word]);
+  } else {
+    PackCodesGeneric(codes, len, &planes_[first_word],
+        &rc_planes_[first_word]);
+  }
+#else
+  PackCodesGeneric(codes, len, &planes_[first_word], &rc_planes_[first_word]);
+#endif
+  block_offsets_.push_back(block_offsets_.back() + blocks);
+  lengths_.push_back(len);
+  if (len > max_length_) max_length_ = len;
+  names_.append(name, name + name_len);
+  name_offsets_.push_back(names_.size());
+}
+
+void PrimerPanel::Save(IndexWriter* writer) const {
+  writer->WriteArray(planes_);
+  writer->WriteArray(rc_planes_);
+  writer->WriteArray(block_offsets_);
+  writer->WriteArray(lengths_);
+  writer->WriteArray(names_);
+  writer->WriteArray(name_offsets_);
+  writer->WriteValue(max_length_);
+}
+
+void PrimerPanel::Load(IndexReader* reader) {
+  reader->ReadArray(&planes_);
+  reader->ReadArray(&rc_planes_);
+  reader->ReadArray(&block_offsets_);
+  reader->ReadArray(&lengths_);
+  reader->ReadArray(&names_);
+  reader->ReadArray(&name_offsets_);
+  max_length_ = reader->ReadValue();
+}
+
+std::string PrimerPanel::Sequence(unsigned i) const {
+  std::string ret_str(Length(i), 'A');
+  for (unsigned pos = 0; pos < Length(i); ++pos) {
+    ret_str[pos] = DecodeBase(Base(i, pos));
+  }
+  return ret_str;
+}
+
+std::string PrimerPanel::RcSequence(unsigned i) const {
+  std::string ret_str(Length(i), 'A');
+  for (unsigned pos = 0; pos < Length(i); ++pos) {
+    ret_str[pos] = DecodeBase(RcBase(i, pos));
+  }
+  return ret_str;
+}
@@ -0,0 +1,111 @@
+#ifndef PRIMER_PANEL_H
+#define PRIMER_PANEL_H
+
+#include <stdint.h>     // for uint8_t, uint64_t
+
+#include <string>       // for std::string
+
+#include "mapped_array.h"
+
+class IndexReader;
+class IndexWriter;
+
+const unsigned number_of_bases = 4;
+
+// 2-bit base codes. The complement of a base is its code ^ 1.
+enum BaseCode { kBaseA = 0, kBaseT = 1, kBaseC = 2, kBaseG = 3 };
+
+// returns the 2-bit code of an upper case base, or -1 if c is not a base
+int EncodeBase(char c);
+char DecodeBase(unsigned code);
+// Writes the 2-bit codes of the len bases at bases, which may be upper or
+// lower case, to codes. Returns false if any character is not a base.
+bool EncodeBases(const char* bases, unsigned len, uint8_t* codes);
+
+std::string ReverseComplement(const std::string &src);
+bool ValidSequence(const std::string &str);
+
+// A panel of primers packed into contiguous arrays.
+//
+// Sequences are stored 2 bits per base as pairs of 64-bit bit planes: for
+// every block of 64 bases there is a low plane word followed by a high plane
+// word, and bit p of the two planes together give the code of base p of the
+// block. Each primer starts on a block boundary and unused bits are zero.
+// The reverse complement of every primer is packed alongside in the same
+// layout, so that stages never need to build it themselves. Names live in a
+// separate character arena so that the sequence data stays dense. A panel
+// loaded from an index file views the arrays in the mapped file instead of
+// owning them, and cannot be appended to.
+class PrimerPanel {
+ public:
+  void Append(const std::string &name, const std::string &sequence);
+  // appends a primer from its name and the 2-bit codes of its bases
+  void Append(const char* name, unsigned name_len, const uint8_t* codes,
+      unsigned len);
+  void Reserve(unsigned number_of_primers, unsigned total_bases,
+      unsigned total_name_bytes = 0);
+  void Save(IndexWriter* writer) const;
+  void Load(IndexReader* reader);
+
+  unsigned size() const {
+    return lengths_.size();
+  }
+  bool empty() const {
+    return lengths_.empty();
+  }
+  unsigned Length(unsigned i) const {
+    return lengths_[i];
+  }
+  unsigned MaxLength() const {
+    return max_length_;
+  }
+  // number of 64-base blocks used by primer i
+  unsigned Blocks(unsigned i) const {
+    return block_offsets_[i + 1] - block_offsets_[i];
+  }
+  // the plane words of primer i: low plane of block b at [2 * b], high plane
+  // at [2 * b + 1]
+  const uint64_t* Planes(unsigned i) const {
+    return &planes_[2 * block_offsets_[i]];
+  }
+  const uint64_t* RcPlanes(unsigned i) const {
+    return &rc_planes_[2 * block_offsets_[i]];
+  }
+  unsigned Base(unsigned i, unsigned pos) const {
+    return PlaneBase(Planes(i), pos);
+  }
+  // base pos of the reverse complement of primer i
+  unsigned RcBase(unsigned i, unsigned pos) const {
+    return PlaneBase(RcPlanes(i), pos);
+  }
+
+  const char* NameData(unsigned i) const {
+    return names_.data() + name_offsets_[i];
+  }
+  unsigned NameLength(unsigned i) const {
+    return name_offsets_[i + 1] - name_offsets_[i];
+  }
+  std::string Name(unsigned i) const {
+    return std::string(NameData(i), NameLength(i));
+  }
+  // decoded copies, for printing and debugging only
+  std::string Sequence(unsigned i) const;
+  std::string RcSequence(unsigned i) const;
+
+  static unsigned PlaneBase(const uint64_t* planes, unsigned pos) {
+    const uint64_t* block = planes + 2 * (pos / 64);
+    unsigned bit = pos % 64;
+    return ((block[0] >> bit) & 1) | (((block[1] >> bit) & 1) << 1);
+  }
+
+ private:
+  MappedArray<uint64_t> planes_;
+  MappedArray<uint64_t> rc_planes_;
+  MappedArray<unsigned> block_offsets_ = MappedArray<unsigned>(1, 0);
+  MappedArray<unsigned> lengths_;
+  MappedArray<char> names_;
+  MappedArray<unsigned> name_offsets_ = MappedArray<unsigned>(1, 0);
+  unsigned max_length_ = 0;
+};
+
+#endif
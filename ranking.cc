@@ -0,0 +1,138 @@
+#include "ranking.h"
+
+#include <algorithm>    // for std::min, std::push_heap, std::sort_heap
+
+#include "lcs.h"
+
+namespace {
+
+// the primers' heaps are guarded by this many locks, primer i by lock
+// i % lock_stripes
+const unsigned lock_stripes = 256;
+
+// whether a ranks above b
+bool Outranks(const RankedPair &a, const RankedPair &b) {
+  if (a.score != b.score) return a.score > b.score;
+  if (a.primer != b.primer) return a.primer < b.primer;
+  return a.candidate.partner < b.candidate.partner;
+}
+
+// Adds pair to the heap in [heap, heap + *size) if it is among the top best
+// seen, the lowest ranked of those at the top of the heap.
+void Keep(RankedPair* heap, unsigned* size, unsigned top,
+    const RankedPair &pair) {
+  if (*size < top) {
+    heap[(*size)++] = pair;
+    std::push_heap(heap, heap + *size, Outranks);
+  } else if (Outranks(pair, heap[0])) {
+    std::pop_heap(heap, heap + top, Outranks);
+    heap[top - 1] = pair;
+    std::push_heap(heap, heap + top, Outranks);
+  }
+}
+
+}  // namespace
+
+PairRanking::PairRanking(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned j, bool coarse, RankBy rank_by,
+    unsigned top, unsigned threads)
+    : primers_(primers), kernel_(primers, tail_len, max_mismatches, j, coarse),
+      tail_len_(tail_len), rank_by_(rank_by), top_(top),
+      entries_(static_cast<size_t>(primers.size()) * top),
+      sizes_(primers.size(), 0), locks_(lock_stripes),
+      thread_heaps_(threads) {
+  for (ThreadHeap &heap : thread_heaps_) heap.global.resize(top);
+}
+
+unsigned PairRanking::Score(unsigned i, Candidate* candidate) const {
+  unsigned k = candidate->partner;
+  if (candidate->lcs_len == 0
+      && (rank_by_ == kRankByLcs || rank_by_ == kRankByCombined)) {
+    candidate->lcs_len = LcsLen(primers_, i, k);
+  }
+  unsigned tail = 0;
+  if (rank_by_ == kRankByTail || rank_by_ == kRankByCombined) {
+    tail = tail_len_ - std::min(kernel_.TailMismatches(i, k), tail_len_);
+  }
+  switch (rank_by_) {
+    case kRankByJmers:
+      return candidate->jmers;
+    case kRankByLcs:
+      return candidate->lcs_len;
+    case kRankByTail:
+      return tail;
+    default:
+      return candidate->jmers + candidate->lcs_len + tail;
+  }
+}
+
+void PairRanking::Add(unsigned i, const std::vector<Candidate> &row,
+    unsigned thread) {
+  if (top_ == 0) return;
+  ThreadHeap &heap = thread_heaps_[thread];
+  // score the row before taking any lock
+  std::vector<RankedPair> &scored = heap.scored;
+  scored.clear();
+  for (Candidate candidate : row) {
+    unsigned score = Score(i, &candidate);
+    RankedPair pair = {i, score, candidate};
+    scored.push_back(pair);
+    Keep(heap.global.data(), &heap.global_size, top_, pair);
+    heap.pairs += candidate.partner == i ? 1 : 2;
+  }
+  {
+    std::lock_guard<std::mutex> lock(locks_[i % lock_stripes]);
+    for (const RankedPair &pair : scored) {
+      Keep(&entries_[static_cast<size_t>(i) * top_], &sizes_[i], top_, pair);
+    }
+  }
+  for (const RankedPair &pair : scored) {
+    unsigned k = pair.candidate.partner;
+    if (k == i) continue;
+    RankedPair mirrored = pair;
+    mirrored.primer = k;
+    mirrored.candidate.partner = i;
+    std::lock_guard<std::mutex> lock(locks_[k % lock_stripes]);
+    Keep(&entries_[static_cast<size_t>(k) * top_], &sizes_[k], top_,
+        mirrored);
+  }
+}
+
+void PairRanking::Finish() {
+  ThreadHeap &merged = thread_heaps_[0];
+  for (unsigned t = 1; t < thread_heaps_.size(); ++t) {
+    const ThreadHeap &heap = thread_heaps_[t];
+    for (unsigned e = 0; e < heap.global_size; ++e) {
+      Keep(merged.global.data(), &merged.global_size, top_, heap.global[e]);
+    }
+    merged.pairs += heap.pairs;
+  }
+  std::vector<RankedPair>().swap(merged.scored);
+  thread_heaps_.resize(1);
+  pairs_ = merged.pairs;
+}
+
+void PairRanking::Row(unsigned i, std::vector<Candidate>* row) const {
+  row->clear();
+  if (top_ == 0) return;
+  std::vector<RankedPair> ranked(
+      entries_.begin() + static_cast<size_t>(i) * top_,
+      entries_.begin() + static_cast<size_t>(i) * top_ + sizes_[i]);
+  std::sort_heap(ranked.begin(), ranked.end(), Outranks);
+  for (const RankedPair &pair : ranked) row->push_back(pair.candidate);
+}
+
+std::vector<RankedPair> PairRanking::Global() const {
+  const ThreadHeap &heap = thread_heaps_[0];
+  std::vector<RankedPair> ranked(heap.global.begin(),
+      heap.global.begin() + heap.global_size);
+  std::sort_heap(ranked.begin(), ranked.end(), Outranks);
+  // the few pairs listed all get their lcs
+  for (RankedPair &pair : ranked) {
+    if (pair.candidate.lcs_len == 0) {
+      pair.candidate.lcs_len = LcsLen(primers_, pair.primer,
+          pair.candidate.partner);
+    }
+  }
+  return ranked;
+}
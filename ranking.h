@@ -0,0 +1,83 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <mutex>        // for std::mutex
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "pair_kernel.h"
+#include "primer_panel.h"
+
+// What ranks the candidate pairs: their shared j-mers, their longest common
+// substring, the bases of the best tail alignment that match, or the sum of
+// all three. A higher score is a worse dimer.
+enum RankBy { kRankByJmers, kRankByLcs, kRankByTail, kRankByCombined };
+
+struct RankedPair {
+  unsigned primer;
+  unsigned score;
+  Candidate candidate;  // the partner, with its j-mers and lcs_len
+};
+
+// Keeps the top best scoring partners of every primer, and the top best
+// pairs of the whole panel, as the filter pipeline hands over its
+// survivors, so the full list of candidates is never held. The bounded
+// heaps of the primers, top entries each, are shared by the threads adding
+// pairs, each guarded by the lock of its stripe of primers; each thread
+// keeps only a heap of the top pairs of the panel, which Finish merges.
+// Memory grows with top times the number of primers, not with the number
+// of candidates or of threads.
+//
+// Scores the filters did not compute are computed for the pairs ranked:
+// the lcs of pairs from the join, which only tests the threshold, and the
+// tail alignments. Ties go to the lower primer and then the lower partner,
+// so the ranking does not depend on the number of threads.
+class PairRanking {
+ public:
+  PairRanking(const PrimerPanel &primers, unsigned tail_len,
+      unsigned max_mismatches, unsigned j, bool coarse, RankBy rank_by,
+      unsigned top, unsigned threads);
+
+  // ranks the pairs (i, k) of row, all with k >= i, for both primers, from
+  // thread, which no other thread may be adding from at the same time
+  void Add(unsigned i, const std::vector<Candidate> &row, unsigned thread);
+  // merges the threads' heaps of the top pairs; call it once every pair
+  // is added
+  void Finish();
+
+  // the ordered pairs added, each (i, k) with i != k counting twice
+  unsigned long long Pairs() const {
+    return pairs_;
+  }
+  // the top partners of primer i, best first
+  void Row(unsigned i, std::vector<Candidate>* row) const;
+  // the top pairs of the panel, best first, each with primer < partner or
+  // a primer paired with itself, and each with its lcs
+  std::vector<RankedPair> Global() const;
+
+ private:
+  struct ThreadHeap {
+    // the global heap in global[0, global_size)
+    std::vector<RankedPair> global;
+    unsigned global_size = 0;
+    unsigned long long pairs = 0;
+    std::vector<RankedPair> scored;  // the pairs of the row being added
+  };
+
+  unsigned Score(unsigned i, Candidate* candidate) const;
+
+  const PrimerPanel &primers_;
+  PairKernel kernel_;
+  unsigned tail_len_;
+  RankBy rank_by_;
+  unsigned top_;
+  // the heap of primer i in entries_[i * top, i * top + sizes_[i]), guarded
+  // by locks_[i % locks_.size()]
+  std::vector<RankedPair> entries_;
+  std::vector<unsigned> sizes_;
+  std::vector<std::mutex> locks_;
+  std::vector<ThreadHeap> thread_heaps_;
+  unsigned long long pairs_ = 0;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "result_writer.h"
+
+#include <string.h>     // for memcpy()
+
+#include <utility>      // for std::move
+
+namespace {
+
+void AppendUnsigned(std::string* buffer, unsigned value) {
+  char digits[10];
+  unsigned n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) buffer->push_back(digits[--n]);
+}
+
+void AppendName(std::string* buffer, const PrimerPanel &primers, unsigned i) {
+  buffer->append(primers.NameData(i), primers.NameLength(i));
+}
+
+}  // namespace
+
+ResultWriter::ResultWriter(FILE* file, OutputFormat format)
+    : file_(file), format_(format),
+      thread_(&ResultWriter::WriterLoop, this) {
+  buffer_.reserve(buffer_bytes);
+  if (format_ == kTsvOutput) {
+    buffer_ += "primer\tpartner\tjmers\tlcs_len\n";
+  } else if (format_ == kBinaryOutput) {
+    PairFileHeader header = {};
+    memcpy(header.magic, pair_file_magic, sizeof(header.magic));
+    header.version = pair_file_version;
+    header.record_bytes = sizeof(PairRecord);
+    buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+}
+
+ResultWriter::~ResultWriter() {
+  Close();
+}
+
+void ResultWriter::WriteRow(const PrimerPanel &primers, unsigned i,
+    const Candidate* first, const Candidate* last) {
+  for (const Candidate* candidate = first; candidate != last; ++candidate) {
+    if (format_ == kTextOutput) {
+      if (candidate == first) {
+        buffer_ += '\n';
+        AppendName(&buffer_, primers, i);
+        buffer_ += " : ";
+      } else {
+        buffer_ += ", ";
+      }
+      AppendName(&buffer_, primers, candidate->partner);
+    } else if (format_ == kTsvOutput) {
+      AppendName(&buffer_, primers, i);
+      buffer_ += '\t';
+      AppendName(&buffer_, primers, candidate->partner);
+      buffer_ += '\t';
+      AppendUnsigned(&buffer_, candidate->jmers);
+      buffer_ += '\t';
+      AppendUnsigned(&buffer_, candidate->lcs_len);
+      buffer_ += '\n';
+    } else {
+      PairRecord record = {i, candidate->partner, candidate->jmers,
+          candidate->lcs_len};
+      buffer_.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+    if (buffer_.size() >= buffer_bytes) Flush();
+  }
+}
+
+void ResultWriter::Flush() {
+  if (buffer_.empty()) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return pending_.size() < max_pending; });
+  pending_.push_back(std::move(buffer_));
+  changed_.notify_all();
+  lock.unlock();
+  buffer_.clear();
+  buffer_.reserve(buffer_bytes);
+}
+
+bool ResultWriter::Close() {
+  if (closed_) return !failed_;
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+  closed_ = true;
+  if (fflush(file_) != 0) failed_ = true;
+  return !failed_;
+}
+
+void ResultWriter::WriterLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this] { return !pending_.empty() || closing_; });
+    if (pending_.empty()) return;
+    std::string buffer = std::move(pending_.front());
+    pending_.pop_front();
+    changed_.notify_all();
+    // write without the lock, so the caller can queue the next buffer
+    lock.unlock();
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file_)
+        == buffer.size();
+    lock.lock();
+    if (!written) failed_ = true;
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <stddef.h>     // for size_t
+#include <stdint.h>     // for uint16_t, uint32_t
+#include <stdio.h>      // for FILE
+
+#include <condition_variable>  // for std::condition_variable
+#include <deque>        // for std::deque
+#include <mutex>        // for std::mutex
+#include <string>       // for std::string
+#include <thread>       // for std::thread
+
+#include "candidate_pairs.h"
+#include "primer_panel.h"
+
+// How candidate pairs are written: the listing main has always printed, one
+// line per primer with its partners; one pair per line as tab separated
+// names and scores; or a binary pair file.
+enum OutputFormat { kTextOutput, kTsvOutput, kBinaryOutput };
+
+// The layout of a binary pair file: this header, then a PairRecord for each
+// pair up to the end of the file. Primers are numbered in the order of the
+// input file, with appended primers after the panel, and values are in the
+// byte order of the machine which wrote the file.
+struct PairFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_bytes;
+};
+
+// jmers is the number of j-mers the pair shares and lcs_len the length of
+// its longest common substring.
+struct PairRecord {
+  uint32_t primer;
+  uint32_t partner;
+  uint16_t jmers;
+  uint16_t lcs_len;
+};
+
+const char pair_file_magic[8] = {'P', 'D', 'I', 'M', 'E', 'R', 'P', 'R'};
+const uint32_t pair_file_version = 1;
+
+// Writes candidate pairs to a file from a thread of its own. Rows are
+// formatted into a buffer of about buffer_bytes, without copying any
+// names, and each full buffer is handed to the writer thread, so the
+// caller only formats while earlier buffers are written out. Up to
+// max_pending buffers wait for the writer at once; beyond that the caller
+// waits for it.
+//
+// The file stays the caller's; nothing else may write to it until Close
+// returns.
+class ResultWriter {
+ public:
+  ResultWriter(FILE* file, OutputFormat format);
+  ResultWriter(const ResultWriter &) = delete;
+  ResultWriter &operator=(const ResultWriter &) = delete;
+  ~ResultWriter();
+
+  // writes primer i of primers with the partners [first, last), which may
+  // be empty
+  void WriteRow(const PrimerPanel &primers, unsigned i, const Candidate* first,
+      const Candidate* last);
+  void WriteRows(const PrimerPanel &primers, const CandidatePairs &candidates) {
+    for (unsigned i = 0; i < candidates.Rows(); ++i) {
+      WriteRow(primers, i, candidates[i].begin(), candidates[i].end());
+    }
+  }
+  // Writes out everything and stops the writer thread, returning false if
+  // any write to the file failed.
+  bool Close();
+
+  static const size_t buffer_bytes = 1 << 20;
+  static const size_t max_pending = 4;
+
+ private:
+  // hands the buffer to the writer thread
+  void Flush();
+  void WriterLoop();
+
+  FILE* file_;
+  OutputFormat format_;
+  std::string buffer_;
+  bool closed_ = false;
+  // shared with the writer thread
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::string> pending_;
+  bool closing_ = false;
+  bool failed_ = false;
+  std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,398 @@
+#include "sweep.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>  // for AVX2 intrinsics
+#endif
+#include <math.h>       // for pow()
+#include <stdint.h>     // for uint32_t, uint64_t
+#include <stdio.h>      // for printf
+
+#include <algorithm>    // for std::min, std::max
+
+#include "jmer_matching.h"
+#include "kmer.h"
+#include "lcs.h"
+#include "pair_kernel.h"
+#include "parallel.h"
+#include "tail_matching.h"
+
+namespace {
+
+// 32 bits of the low (plane 0) or high (plane 1) plane from base pos of a
+// primer packed in blocks blocks, zero past its end
+uint32_t PlaneBits(const uint64_t* planes, unsigned blocks, unsigned pos,
+    unsigned plane) {
+  unsigned b = pos / 64;
+  unsigned bit = pos % 64;
+  uint64_t bits = planes[2 * b + plane] >> bit;
+  if (bit > 32 && b + 1 < blocks) {
+    bits |= planes[2 * (b + 1) + plane] << (64 - bit);
+  }
+  return static_cast<uint32_t>(bits);
+}
+
+// bits [limit, 32) of a mismatch mask, which stop a comparison at limit
+// bases (at most 31)
+uint32_t StopBits(unsigned limit) {
+  return ~0u << std::min(limit, 31u);
+}
+
+// The bases of every window and tail as 32-bit plane words, one bit per
+// base, so that one xor compares up to 31 bases of a window with a tail. A
+// window or tail is cut short by its stop bits, set from the first base
+// past its end; a window that does not exist is all stop bits.
+struct TailPlanes {
+  unsigned number_of_primers;
+  unsigned starts;
+  // windows by start: the window at start s of primer k is at s * n + k
+  std::vector<uint32_t> window_lo;
+  std::vector<uint32_t> window_hi;
+  std::vector<uint32_t> window_stop;
+  // the start of the reverse complement of each primer, its 3' tail
+  std::vector<uint32_t> tail_lo;
+  std::vector<uint32_t> tail_hi;
+  std::vector<uint32_t> tail_stop;
+
+  explicit TailPlanes(const PrimerPanel &primers)
+      : number_of_primers(primers.size()), starts(primers.MaxLength()),
+        window_lo(static_cast<size_t>(starts) * number_of_primers, 0),
+        window_hi(window_lo.size(), 0), window_stop(window_lo.size(), ~0u),
+        tail_lo(number_of_primers), tail_hi(number_of_primers),
+        tail_stop(number_of_primers) {
+    for (unsigned k = 0; k < number_of_primers; ++k) {
+      unsigned len = primers.Length(k);
+      for (unsigned s = 0; s < len; ++s) {
+        size_t w = static_cast<size_t>(s) * number_of_primers + k;
+        window_lo[w] = PlaneBits(primers.Planes(k), primers.Blocks(k), s, 0);
+        window_hi[w] = PlaneBits(primers.Planes(k), primers.Blocks(k), s, 1);
+        window_stop[w] = StopBits(len - s);
+      }
+      tail_lo[k] = PlaneBits(primers.RcPlanes(k), primers.Blocks(k), 0, 0);
+      tail_hi[k] = PlaneBits(primers.RcPlanes(k), primers.Blocks(k), 0, 1);
+      tail_stop[k] = StopBits(len);
+    }
+  }
+};
+
+// Compares the sequence (lo, hi, stop) with each of the n sequences of los,
+// his and stops. For lane k, whose first bases must agree, the lowest set
+// bit of the mismatch mask after removing r of them is the (r + 1)-th
+// mismatch, or the first stop bit if there are fewer: the longest tail
+// matched with r mismatches, as a power of two. reach[r * stride + k] keeps
+// the largest over every call, for r < rounds.
+void ReachGeneric(uint32_t lo, uint32_t hi, uint32_t stop,
+    const uint32_t* los, const uint32_t* his, const uint32_t* stops,
+    unsigned n, unsigned rounds, uint32_t* reach, unsigned stride) {
+  for (unsigned k = 0; k < n; ++k) {
+    uint32_t stop_bits = stop | stops[k];
+    uint32_t mask = (lo ^ los[k]) | (hi ^ his[k]) | stop_bits;
+    if (mask & 1) continue;
+    uint32_t cap = stop_bits & (0u - stop_bits);
+    for (unsigned r = 0; r < rounds; ++r) {
+      uint32_t low = mask & (0u - mask);
+      mask ^= low;
+      uint32_t &best = reach[r * stride + k];
+      best = std::max(best, std::min(low, cap));
+    }
+  }
+}
+
+#if defined(__x86_64__)
+// ReachGeneric eight lanes at a time; a lane whose first bases differ gets
+// a cap of zero
+__attribute__((target("avx2")))
+void ReachAvx2(uint32_t lo, uint32_t hi, uint32_t stop,
+    const uint32_t* los, const uint32_t* his, const uint32_t* stops,
+    unsigned n, unsigned rounds, uint32_t* reach) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i lo_v = _mm256_set1_epi32(lo);
+  const __m256i hi_v = _mm256_set1_epi32(hi);
+  const __m256i stop_v = _mm256_set1_epi32(stop);
+  unsigned k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256i stop_bits = _mm256_or_si256(stop_v,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stops + k)));
+    __m256i mask = _mm256_or_si256(_mm256_or_si256(
+        _mm256_xor_si256(lo_v,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(los + k))),
+        _mm256_xor_si256(hi_v,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(his + k)))),
+        stop_bits);
+    __m256i first_equal = _mm256_cmpeq_epi32(_mm256_and_si256(mask, one),
+        zero);
+    __m256i cap = _mm256_and_si256(first_equal, _mm256_and_si256(stop_bits,
+        _mm256_sub_epi32(zero, stop_bits)));
+    for (unsigned r = 0; r < rounds; ++r) {
+      __m256i low = _mm256_and_si256(mask, _mm256_sub_epi32(zero, mask));
+      mask = _mm256_xor_si256(mask, low);
+      __m256i* best = reinterpret_cast<__m256i*>(reach + r * n + k);
+      _mm256_storeu_si256(best, _mm256_max_epu32(_mm256_loadu_si256(best),
+          _mm256_min_epu32(low, cap)));
+    }
+  }
+  ReachGeneric(lo, hi, stop, los + k, his + k, stops + k, n - k, rounds,
+      reach + k, n);
+}
+
+bool UseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+const bool use_avx2 = UseAvx2();
+#endif
+
+void Reach(uint32_t lo, uint32_t hi, uint32_t stop, const uint32_t* los,
+    const uint32_t* his, const uint32_t* stops, unsigned n, unsigned rounds,
+    uint32_t* reach) {
+#if defined(__x86_64__)
+  if (use_avx2) {
+    ReachAvx2(lo, hi, stop, los, his, stops, n, rounds, reach);
+    return;
+  }
+#endif
+  ReachGeneric(lo, hi, stop, los, his, stops, n, rounds, reach, n);
+}
+
+// Sums per-thread counts, each of the same size, into the first.
+void SumCounts(std::vector<std::vector<unsigned long long>>* counts) {
+  for (unsigned t = 1; t < counts->size(); ++t) {
+    for (size_t c = 0; c < (*counts)[t].size(); ++c) {
+      (*counts)[0][c] += (*counts)[t][c];
+    }
+  }
+}
+
+}  // namespace
+
+std::vector<std::vector<unsigned long long>> SweepTails(
+    const PrimerPanel &primers, unsigned max_tail_len, unsigned max_mismatches,
+    unsigned threads) {
+  const unsigned n = primers.size();
+  const unsigned rounds = max_mismatches + 1;
+  TailPlanes planes(primers);
+
+  // longest[t][r * 32 + p]: pairs whose longest tail with r mismatches is p
+  threads = ResolveThreads(threads);
+  std::vector<unsigned> firsts = TriangleRowBlocks(n, 16 * threads);
+  std::vector<std::vector<unsigned long long>> longest(threads,
+      std::vector<unsigned long long>(rounds * 32, 0));
+  ParallelForBlocks(firsts.size() - 1, threads, [&](unsigned b, unsigned t) {
+    std::vector<uint32_t> reach;
+    for (unsigned i = firsts[b]; i < firsts[b + 1]; ++i) {
+      // row i holds the pairs (i, k >= i), compared both ways round
+      unsigned partners = n - i;
+      reach.assign(rounds * partners, 0);
+      for (unsigned s = 1; s < primers.Length(i); ++s) {
+        size_t w = static_cast<size_t>(s) * n + i;
+        Reach(planes.window_lo[w], planes.window_hi[w], planes.window_stop[w],
+            &planes.tail_lo[i], &planes.tail_hi[i], &planes.tail_stop[i],
+            partners, rounds, reach.data());
+      }
+      for (unsigned s = 1; s < planes.starts; ++s) {
+        size_t w = static_cast<size_t>(s) * n + i;
+        Reach(planes.tail_lo[i], planes.tail_hi[i], planes.tail_stop[i],
+            &planes.window_lo[w], &planes.window_hi[w], &planes.window_stop[w],
+            partners, rounds, reach.data());
+      }
+      for (unsigned r = 0; r < rounds; ++r) {
+        for (unsigned k = 0; k < partners; ++k) {
+          uint32_t best = reach[r * partners + k];
+          unsigned p = best == 0 ? 0 : __builtin_ctz(best);
+          longest[t][r * 32 + p] += k == 0 ? 1 : 2;
+        }
+      }
+    }
+  });
+  SumCounts(&longest);
+
+  // a pair matches every tail up to its longest
+  std::vector<std::vector<unsigned long long>> hits(rounds,
+      std::vector<unsigned long long>(max_tail_len + 1, 0));
+  for (unsigned r = 0; r < rounds; ++r) {
+    for (unsigned tail_len = 0; tail_len <= max_tail_len; ++tail_len) {
+      for (unsigned p = tail_len; p < 32; ++p) {
+        hits[r][tail_len] += longest[0][r * 32 + p];
+      }
+    }
+  }
+  return hits;
+}
+
+std::vector<unsigned long long> SweepJmers(const PrimerPanel &primers,
+    unsigned j, unsigned threads) {
+  // one signature of the j-mers of each primer and one of those of its
+  // reverse complement
+  const unsigned n = primers.size();
+  const unsigned words = (KmerCount(j) + 63) / 64;
+  std::vector<uint64_t> signatures(static_cast<size_t>(n) * words, 0);
+  std::vector<uint64_t> rc_signatures(signatures.size(), 0);
+  for (unsigned i = 0; i < n; ++i) {
+    uint64_t* signature = &signatures[static_cast<size_t>(i) * words];
+    uint64_t* rc_signature = &rc_signatures[static_cast<size_t>(i) * words];
+    ForEachKmer(primers, i, j, [&](unsigned start, kmer_t jmer, kmer_t jmer_rc) {
+      if (start == 0) return;
+      signature[jmer / 64] |= 1ull << (jmer % 64);
+      rc_signature[jmer_rc / 64] |= 1ull << (jmer_rc % 64);
+    });
+  }
+
+  threads = ResolveThreads(threads);
+  std::vector<unsigned> firsts = TriangleRowBlocks(n, 16 * threads);
+  std::vector<std::vector<unsigned long long>> shared(threads,
+      std::vector<unsigned long long>(primers.MaxLength() + 1, 0));
+  ParallelForBlocks(firsts.size() - 1, threads, [&](unsigned b, unsigned t) {
+    for (unsigned i = firsts[b]; i < firsts[b + 1]; ++i) {
+      const uint64_t* rc_signature = &rc_signatures[static_cast<size_t>(i) * words];
+      for (unsigned k = i; k < n; ++k) {
+        ++shared[t][PopcountAnd(rc_signature,
+            &signatures[static_cast<size_t>(k) * words], words)];
+      }
+    }
+  });
+  SumCounts(&shared);
+  return shared[0];
+}
+
+std::vector<unsigned long long> SweepLcs(const PrimerPanel &primers,
+    unsigned threads) {
+  const unsigned n = primers.size();
+  threads = ResolveThreads(threads);
+  std::vector<unsigned> firsts = TriangleRowBlocks(n, 16 * threads);
+  std::vector<std::vector<unsigned long long>> lcs(threads,
+      std::vector<unsigned long long>(primers.MaxLength() + 1, 0));
+  ParallelForBlocks(firsts.size() - 1, threads, [&](unsigned b, unsigned t) {
+    std::vector<unsigned> targets;
+    std::vector<unsigned> lcs_lens(n);
+    for (unsigned i = firsts[b]; i < firsts[b + 1]; ++i) {
+      targets.clear();
+      for (unsigned k = i; k < n; ++k) targets.push_back(k);
+      LcsLenBatch(primers, i, targets.data(), targets.size(), lcs_lens.data());
+      for (unsigned k = 0; k < targets.size(); ++k) {
+        lcs[t][lcs_lens[k]] += k == 0 ? 1 : 2;
+      }
+    }
+  });
+  SumCounts(&lcs);
+  return lcs[0];
+}
+
+std::vector<unsigned long long> SweepJoint(const PrimerPanel &primers,
+    unsigned tail_len, unsigned max_mismatches, unsigned j, bool coarse,
+    unsigned minimum_matching_jmers, unsigned minimum_lcs_threshold,
+    unsigned threads) {
+  const unsigned n = primers.size();
+  threads = ResolveThreads(threads);
+  PairKernel kernel(primers, tail_len, max_mismatches, j, coarse);
+  std::vector<unsigned> firsts = TriangleRowBlocks(n, 16 * threads);
+  std::vector<std::vector<unsigned long long>> joint(threads,
+      std::vector<unsigned long long>(8, 0));
+  ParallelForBlocks(firsts.size() - 1, threads, [&](unsigned b, unsigned t) {
+    std::vector<unsigned> targets;
+    std::vector<PairScores> scores(n);
+    for (unsigned i = firsts[b]; i < firsts[b + 1]; ++i) {
+      targets.clear();
+      for (unsigned k = i; k < n; ++k) targets.push_back(k);
+      kernel.ScoreBatch(i, targets.data(), targets.size(), scores.data());
+      for (unsigned k = 0; k < targets.size(); ++k) {
+        unsigned mask = (scores[k].tail ? kTailTest : 0)
+            | (scores[k].jmers >= minimum_matching_jmers ? kJmerTest : 0)
+            | (scores[k].lcs_len >= minimum_lcs_threshold ? kLcsTest : 0);
+        joint[t][mask] += k == 0 ? 1 : 2;
+      }
+    }
+  });
+  SumCounts(&joint);
+  return joint[0];
+}
+
+void PrintTailSweep(const PrimerPanel &primers, unsigned min_tail_len,
+    unsigned max_tail_len, unsigned max_mismatches, unsigned threads) {
+  unsigned long long number_of_primers = primers.size();
+  auto hits = SweepTails(primers, max_tail_len, max_mismatches, threads);
+  printf("+------------+--------+-----------+-------------+-------------+\n");
+  printf("| max        | tail   | total     | actual      | expected    |\n");
+  printf("| mismatches | length | entries   | hit         | hit         |\n");
+  printf("|            |        | in        | probability | probability |\n");
+  printf("|            |        | hashtable |             |             |\n");
+  printf("+------------+--------+-----------+-------------+-------------+\n");
+  for (unsigned tail_len = min_tail_len; tail_len <= max_tail_len; ++tail_len) {
+    for (unsigned mismatches = 0; mismatches <= max_mismatches; ++mismatches) {
+      printf("| %-11u| %-7u|", mismatches, tail_len);
+      // the entries a table of every sequence within mismatches of each
+      // tail would hold; TailMatcher finds the same hits without building it
+      printf(" %-10llu|",
+          number_of_primers * NeighbourhoodSize(tail_len, mismatches));
+      // hits counts every (i, j) of the full table, so it is the sum of the
+      // hits of each primer
+      double avg_hits = hits[mismatches][tail_len] / (double)number_of_primers;
+      printf(" %-12f|", avg_hits / number_of_primers);
+      if (mismatches == 0) {
+        // the chance of the tail as a substring of a random primer
+        double expected = ((double)primers.MaxLength() - tail_len + 1)
+            * pow(1.0 / number_of_bases, tail_len);
+        printf(" %-12f|", expected);
+      }
+      printf("\n");
+      printf("+------------+--------+-----------+-------------+-------------+\n");
+    }
+  }
+}
+
+void PrintJmerSweep(const PrimerPanel &primers, unsigned j, unsigned threads) {
+  std::vector<unsigned long long> stats = SweepJmers(primers, j, threads);
+  unsigned long long total = 0;
+  unsigned long long pairs = 0;
+  for (unsigned m = 0; m < stats.size(); ++m) {
+    total += m * stats[m];
+    pairs += stats[m];
+  }
+  printf("avg matches = %f\n", total / (double)pairs);
+  printf("all_matches.size() = %f\n", (double)pairs);
+  for (unsigned m = 0; m < stats.size(); ++m) {
+    if (stats[m] != 0) {
+      printf("matches = %-10u, occurrences = %-10llu, prob = %-10f\n", m,
+          stats[m], stats[m] / (double)pairs);
+    }
+  }
+}
+
+void PrintLcsSweep(const PrimerPanel &primers, unsigned threads) {
+  std::vector<unsigned long long> stats = SweepLcs(primers, threads);
+  unsigned long long total = 0;
+  unsigned long long pairs = 0;
+  for (unsigned l = 0; l < stats.size(); ++l) {
+    total += l * stats[l];
+    pairs += stats[l];
+  }
+  printf("avg lcs = %f\n", total / (double)pairs);
+  printf("all_lcs.size() = %f\n", (double)pairs);
+  for (unsigned l = 0; l < stats.size(); ++l) {
+    if (stats[l] != 0) {
+      printf("lcs = %-10u, occurrences = %-10llu, prob = %-10f\n", l,
+          stats[l], stats[l] / (double)pairs);
+    }
+  }
+}
+
+void PrintJointSweep(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned j, bool coarse,
+    unsigned minimum_matching_jmers, unsigned minimum_lcs_threshold,
+    unsigned threads) {
+  std::vector<unsigned long long> joint = SweepJoint(primers, tail_len,
+      max_mismatches, j, coarse, minimum_matching_jmers,
+      minimum_lcs_threshold, threads);
+  unsigned long long pairs = 0;
+  for (unsigned long long count : joint) pairs += count;
+  printf("+------+------+-----+----------------+-------------+\n");
+  printf("| tail | jmer | lcs | pairs          | probability |\n");
+  printf("+------+------+-----+----------------+-------------+\n");
+  for (unsigned mask = 0; mask < joint.size(); ++mask) {
+    printf("| %-5s| %-5s| %-4s| %-15llu| %-12f|\n",
+        mask & kTailTest ? "yes" : "no", mask & kJmerTest ? "yes" : "no",
+        mask & kLcsTest ? "yes" : "no", joint[mask],
+        joint[mask] / (double)pairs);
+  }
+  printf("+------+------+-----+----------------+-------------+\n");
+}
@@ -0,0 +1,77 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>       // for std::vector
+
+#include "primer_panel.h"
+
+// The pair statistics the calibration tools print, each computed for a
+// whole range of parameters in one pass over the pairs of a panel. The
+// upper triangle of the pair space is split into row blocks which threads
+// threads (0 for one per core) share by work stealing; the counts do not
+// depend on the number of threads.
+//
+// As in the calibration tools, a window of a primer is one of its windows
+// other than the one at its 5' end, and an ordered pair (i, k) with i != k
+// stands for the symmetric entries (i, k) and (k, i) of the full table,
+// with the diagonal counted once.
+
+// Sets hits[mm][t], for mm up to max_mismatches and t up to max_tail_len,
+// to the ordered pairs (i, k) for which a window of one primer is within mm
+// mismatches of the 3' tail of t bases of the other, with the first base of
+// the tail exact. Rather than matching every (t, mm) separately, each pair
+// is compared once at the longest tail: for every window the positions of
+// its first max_mismatches + 1 mismatches give the longest tail it matches
+// with each number of mismatches, and the pair's longest over its windows
+// decides every smaller configuration. Tails of up to 31 bases are
+// supported.
+std::vector<std::vector<unsigned long long>> SweepTails(
+    const PrimerPanel &primers, unsigned max_tail_len, unsigned max_mismatches,
+    unsigned threads);
+
+// Sets shared[m] to the pairs i <= k for which m distinct j-mers of the
+// windows of rc(primer i) are j-mers of the windows of primer k, for j up
+// to max_signature_j.
+std::vector<unsigned long long> SweepJmers(const PrimerPanel &primers,
+    unsigned j, unsigned threads);
+
+// Sets lcs[l] to the ordered pairs (i, k) whose longest common substring
+// of rc(primer i) and primer k is l bases long, for every l up to the
+// longest primer.
+//
+// jmer_counting and lcs_dp need one statistic each, so they keep these
+// loops rather than PairKernel: the j-mer table counts windows the kernel
+// does not, and LcsLenBatch scores 32 pairs a register to the kernel's 4,
+// which would also pay for the tail and j-mer tests only to drop them.
+std::vector<unsigned long long> SweepLcs(const PrimerPanel &primers,
+    unsigned threads);
+
+// The tests of main, each pair scored by one PairKernel, where tail_len,
+// max_mismatches, j and coarse are main's options: sets joint[m] to the
+// ordered pairs (i, k) passing exactly the tests in the mask m, where the
+// bit kTailTest is the 3' tail test, kJmerTest at least
+// minimum_matching_jmers shared j-mers and kLcsTest an LCS of at least
+// minimum_lcs_threshold. Unlike the tables above, these are main's tests
+// on whole primers.
+enum JointTest { kTailTest = 1, kJmerTest = 2, kLcsTest = 4 };
+std::vector<unsigned long long> SweepJoint(const PrimerPanel &primers,
+    unsigned tail_len, unsigned max_mismatches, unsigned j, bool coarse,
+    unsigned minimum_matching_jmers, unsigned minimum_lcs_threshold,
+    unsigned threads);
+
+// The tables of the calibration tools, printed to stdout from one sweep
+// each: the hit probability of every tail length from min_tail_len to
+// max_tail_len with up to max_mismatches mismatches, and the distributions
+// of shared j-mers and of longest common substrings.
+void PrintTailSweep(const PrimerPanel &primers, unsigned min_tail_len,
+    unsigned max_tail_len, unsigned max_mismatches, unsigned threads);
+void PrintJmerSweep(const PrimerPanel &primers, unsigned j, unsigned threads);
+void PrintLcsSweep(const PrimerPanel &primers, unsigned threads);
+// the share of pairs passing each combination of main's tests, and so how
+// many candidates its thresholds leave
+void PrintJointSweep(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned j, bool coarse,
+    unsigned minimum_matching_jmers, unsigned minimum_lcs_threshold,
+    unsigned threads);
+
+#endif
@@ -0,0 +1,178 @@
+#include "tail_matching.h"
+
+#include <algorithm>    // for std::max, std::sort
+
+#include "index_file.h"
+#include "parallel.h"
+
+// dense seeds longer than this would need tables of more than 4^11 buckets,
+// so long tails are split into more segments than the mismatches require
+const unsigned max_seed_len = 10;
+
+unsigned long long NeighbourhoodSize(unsigned tail_len,
+    unsigned max_mismatches) {
+  if (tail_len == 0) return 0;
+  unsigned long long size = 0;
+  unsigned long long choices = 1;  // C(tail_len - 1, d) * 3^d
+  for (unsigned d = 0; d <= max_mismatches && d < tail_len; ++d) {
+    size += choices;
+    choices = choices * (tail_len - 1 - d) * 3 / (d + 1);
+  }
+  return size;
+}
+
+TailMatcher::TailMatcher(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, TailIndex index)
+    : tail_len_(tail_len), max_mismatches_(max_mismatches),
+      end_shift_(2 * (tail_len - 1)), sparse_(index == kSparseTailIndex),
+      tails_(primers.size(), 0) {
+  if (tail_len == 0) return;
+  // the reverse complement of the tail is the start of the packed rc
+  for (unsigned k = 0; k < primers.size(); ++k) {
+    if (primers.Length(k) < tail_len) continue;
+    for (unsigned p = 0; p < tail_len; ++p) {
+      tails_[k] = (tails_[k] << 2) | primers.RcBase(k, p);
+    }
+  }
+
+  // Split the bases after the first into segments. With at least as many
+  // mismatches as bases every tail with the right first base matches, so a
+  // single empty segment keys on the first base alone.
+  unsigned bases = tail_len - 1;
+  unsigned number_of_segments = 1;
+  if (max_mismatches < bases) {
+    number_of_segments = max_mismatches + 1;
+    if (index == kAutomaticTailIndex) {
+      unsigned seed_len = (bases + max_mismatches) / (max_mismatches + 1);
+      sparse_ = seed_len > max_seed_len
+          || KmerCount(seed_len + 1) > primers.size();
+    }
+    if (!sparse_) {
+      number_of_segments = std::max(number_of_segments,
+          (bases + max_seed_len - 1) / max_seed_len);
+    }
+  }
+  std::vector<std::vector<kmer_t>> keys(primers.size());
+  for (unsigned s = 0; s < number_of_segments; ++s) {
+    unsigned first = 1;
+    unsigned last = 1;
+    if (max_mismatches < bases) {
+      first = 1 + bases * s / number_of_segments;
+      last = 1 + bases * (s + 1) / number_of_segments;
+    }
+    unsigned shift = 2 * (tail_len - last);
+    unsigned len = last - first;
+    for (unsigned k = 0; k < primers.size(); ++k) {
+      keys[k].clear();
+      if (primers.Length(k) >= tail_len) {
+        keys[k].push_back(SeedCode(tails_[k], shift, len));
+      }
+    }
+    segments_.push_back({shift, len, KmerMask(len) << shift,
+        TailTable(len + 1, keys, sparse_)});
+  }
+}
+
+TailMatcher::TailMatcher(IndexReader* reader) {
+  tail_len_ = reader->ReadValue();
+  max_mismatches_ = reader->ReadValue();
+  end_shift_ = reader->ReadValue();
+  sparse_ = reader->ReadValue();
+  reader->ReadArray(&tails_);
+  unsigned number_of_segments = reader->ReadValue();
+  for (unsigned s = 0; s < number_of_segments; ++s) {
+    unsigned shift = reader->ReadValue();
+    unsigned len = reader->ReadValue();
+    kmer_t mask = reader->ReadValue();
+    segments_.push_back({shift, len, mask, TailTable(reader)});
+  }
+}
+
+void TailMatcher::Save(IndexWriter* writer) const {
+  writer->WriteValue(tail_len_);
+  writer->WriteValue(max_mismatches_);
+  writer->WriteValue(end_shift_);
+  writer->WriteValue(sparse_);
+  writer->WriteArray(tails_);
+  writer->WriteValue(segments_.size());
+  for (const Segment &segment : segments_) {
+    writer->WriteValue(segment.shift);
+    writer->WriteValue(segment.len);
+    writer->WriteValue(segment.mask);
+    segment.table.Save(writer);
+  }
+}
+
+namespace {
+
+// Appends to block the rows first to last - 1 of tail hits, with last_row
+// the row each primer was last reported in. tail_len is the matcher's tail
+// length, as an unsigned or a FixedLength.
+template <typename Length>
+void ScanTailRows(const PrimerPanel &primers, const TailMatcher &matcher,
+    Length tail_len, unsigned first, unsigned last,
+    std::vector<unsigned>* last_row, CandidatePairs* block) {
+  std::vector<Candidate> row;
+  for (unsigned i = first; i < last; ++i) {
+    row.clear();
+    ForEachKmer(primers, i, tail_len, [&](unsigned, kmer_t window, kmer_t) {
+      matcher.ForEachMatch(window, [&](unsigned k) {
+        if ((*last_row)[k] != i) {
+          (*last_row)[k] = i;
+          row.push_back({k, 0, 0});
+        }
+      });
+    });
+    std::sort(row.begin(), row.end(),
+        [](const Candidate &a, const Candidate &b) {
+          return a.partner < b.partner;
+        });
+    block->AppendRow(row);
+  }
+}
+
+}  // namespace
+
+CandidatePairs MatchTails(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned threads, TailIndex index, bool upper) {
+  TailMatcher matcher(primers, tail_len, max_mismatches, index);
+  return MatchTails(primers, matcher, threads, upper);
+}
+
+CandidatePairs MatchTails(const PrimerPanel &primers,
+    const TailMatcher &matcher, unsigned threads, bool upper) {
+  // row i lists the primers whose tails match a window of primer i; the
+  // hits are symmetric, so the final set is this plus its mirror image
+  unsigned tail_len = matcher.TailLength();
+
+  // threads scan their blocks of rows against the shared matcher, each
+  // block into its own buffer, and the blocks are joined in order
+  threads = ResolveThreads(threads);
+  std::vector<unsigned> firsts = UniformRowBlocks(primers.size(), 16 * threads);
+  std::vector<CandidatePairs> blocks(firsts.size() - 1);
+  std::vector<std::vector<unsigned>> last_rows(threads);
+  ParallelForBlocks(blocks.size(), threads, [&](unsigned b, unsigned t) {
+    std::vector<unsigned> &last_row = last_rows[t];
+    last_row.resize(primers.size(), primers.size());
+    // the common tail lengths run with their windows rolled by constants
+    unsigned first = firsts[b];
+    unsigned last = firsts[b + 1];
+    switch (tail_len) {
+      case 4: ScanTailRows(primers, matcher, FixedLength<4>(), first, last,
+          &last_row, &blocks[b]); break;
+      case 5: ScanTailRows(primers, matcher, FixedLength<5>(), first, last,
+          &last_row, &blocks[b]); break;
+      case 6: ScanTailRows(primers, matcher, FixedLength<6>(), first, last,
+          &last_row, &blocks[b]); break;
+      case 7: ScanTailRows(primers, matcher, FixedLength<7>(), first, last,
+          &last_row, &blocks[b]); break;
+      case 8: ScanTailRows(primers, matcher, FixedLength<8>(), first, last,
+          &last_row, &blocks[b]); break;
+      default: ScanTailRows(primers, matcher, tail_len, first, last,
+          &last_row, &blocks[b]);
+    }
+  });
+  CandidatePairs hit;
+  for (const CandidatePairs &block : blocks) hit.AppendRows(block);
+  return upper ? hit.UpperTriangle() : hit.Symmetric();
+}
@@ -0,0 +1,114 @@
+#ifndef TAIL_MATCHING_H
+#define TAIL_MATCHING_H
+
+#include <vector>       // for std::vector
+
+#include "candidate_pairs.h"
+#include "kmer.h"
+#include "mapped_array.h"
+#include "primer_panel.h"
+#include "tail_table.h"
+
+// The number of sequences within max_mismatches of a tail of tail_len bases
+// which agree with it at the 3' end, the first base of the reverse
+// complemented tail: sum over d of C(tail_len - 1, d) * 3^d.
+unsigned long long NeighbourhoodSize(unsigned tail_len,
+    unsigned max_mismatches);
+
+// Finds the primers whose reverse complemented 3' tail is within
+// max_mismatches of a window of tail_len bases, with the first base of the
+// window (the 3' end of the tail) matching exactly.
+//
+// Rather than storing every sequence in the neighbourhood of each tail, the
+// tail is split into max_mismatches + 1 (or more) segments after its first
+// base; any window within max_mismatches of the tail matches one segment
+// exactly, so each segment indexes the primers under its bases together with
+// the first base. The candidates in the buckets a window hits are verified
+// by XOR and popcount of the packed codes. Memory and time do not depend on
+// the size of the neighbourhood.
+//
+// Dense segment tables are kept to at most 4^11 buckets by cutting long
+// tails into extra segments, which makes the buckets larger. Sparse tables
+// use exactly max_mismatches + 1 segments whatever the tail length, and
+// their memory depends only on the number of primers. Automatic picks
+// sparse tables whenever the dense ones would have more buckets than the
+// panel has primers.
+class TailMatcher {
+ public:
+  TailMatcher(const PrimerPanel &primers, unsigned tail_len,
+      unsigned max_mismatches, TailIndex index = kAutomaticTailIndex);
+  // a matcher saved by Save, viewing the reader's mapping
+  explicit TailMatcher(IndexReader* reader);
+  void Save(IndexWriter* writer) const;
+
+  unsigned TailLength() const {
+    return tail_len_;
+  }
+  unsigned MaxMismatches() const {
+    return max_mismatches_;
+  }
+  bool Sparse() const {
+    return sparse_;
+  }
+  // the entries of all the segment tables
+  size_t TableEntries() const {
+    size_t entries = 0;
+    for (const Segment &segment : segments_) entries += segment.table.size();
+    return entries;
+  }
+  // Calls visit(k) once for every primer k whose tail matches the packed
+  // window of TailLength() bases.
+  template <typename Visitor>
+  void ForEachMatch(kmer_t window, Visitor visit) const;
+
+ private:
+  struct Segment {
+    unsigned shift;       // the segment's bases are window >> shift
+    unsigned len;
+    kmer_t mask;          // the bits of the segment in a window
+    TailTable table;
+  };
+
+  // the first base of window followed by the len bases at window >> shift
+  kmer_t SeedCode(kmer_t window, unsigned shift, unsigned len) const {
+    return ((window >> shift) & KmerMask(len))
+        | ((window >> end_shift_) << (2 * len));
+  }
+
+  unsigned tail_len_;
+  unsigned max_mismatches_;
+  unsigned end_shift_;
+  bool sparse_;
+  MappedArray<kmer_t> tails_;
+  std::vector<Segment> segments_;
+};
+
+template <typename Visitor>
+void TailMatcher::ForEachMatch(kmer_t window, Visitor visit) const {
+  for (unsigned s = 0; s < segments_.size(); ++s) {
+    const Segment &segment = segments_[s];
+    for (unsigned k :
+        segment.table[SeedCode(window, segment.shift, segment.len)]) {
+      kmer_t x = window ^ tails_[k];
+      if (BaseMismatches(x) > max_mismatches_) continue;
+      // report each primer from the first segment it matches exactly
+      unsigned r = 0;
+      while (r < s && (x & segments_[r].mask) != 0) ++r;
+      if (r == s) visit(k);
+    }
+  }
+}
+
+// The pairs (i, k) for which the tail of one primer matches a window of the
+// other, found by threads threads (0 for one per core) each scanning its
+// own rows against a shared TailMatcher with the given index. The hits are
+// symmetric; if upper is true only the pairs with i <= k are kept, which is
+// half the memory and all that a pass over the upper triangle needs.
+CandidatePairs MatchTails(const PrimerPanel &primers, unsigned tail_len,
+    unsigned max_mismatches, unsigned threads,
+    TailIndex index = kAutomaticTailIndex, bool upper = false);
+// as above, with a matcher already built for primers
+CandidatePairs MatchTails(const PrimerPanel &primers,
+    const TailMatcher &matcher, unsigned threads, bool upper = false);
+
+#endif
@@ -0,0 +1,73 @@
+#include "tail_table.h"
+
+#include <algorithm>    // for std::max, std::sort
+#include <utility>      // for std::pair
+
+#include "index_file.h"
+
+TailTable::TailTable(unsigned tail_len,
+    const std::vector<std::vector<kmer_t>> &keys, bool sparse)
+    : tail_len_(tail_len), sparse_(sparse) {
+  if (sparse) {
+    // sort the entries by code, then cut them into buckets
+    std::vector<std::pair<kmer_t, unsigned>> entries;
+    for (unsigned i = 0; i < keys.size(); ++i) {
+      for (kmer_t code : keys[i]) entries.push_back({code, i});
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t e = 0; e < entries.size(); ++e) {
+      if (codes_.empty() || entries[e].first != codes_.back()) {
+        codes_.push_back(entries[e].first);
+        offsets_.push_back(e);
+      }
+      primers_.push_back(entries[e].second);
+    }
+    offsets_.push_back(entries.size());
+    return;
+  }
+
+  // count the entries of every code, turn the counts into the offsets of
+  // the ends of the buckets, then fill each bucket backwards from its end
+  offsets_.assign(KmerCount(tail_len) + 1, 0);
+  for (const std::vector<kmer_t> &codes : keys) {
+    for (kmer_t code : codes) ++offsets_[code + 1];
+  }
+  for (size_t c = 1; c < offsets_.size(); ++c) offsets_[c] += offsets_[c - 1];
+  primers_.resize(offsets_.back());
+  for (unsigned i = keys.size(); i-- > 0;) {
+    for (kmer_t code : keys[i]) primers_[--offsets_[code + 1]] = i;
+  }
+  // every bucket end now holds its start; shift them back into place
+  for (size_t c = 0; c + 1 < offsets_.size(); ++c) offsets_[c] = offsets_[c + 1];
+  offsets_.back() = primers_.size();
+}
+
+TailTable::TailTable(IndexReader* reader) {
+  tail_len_ = reader->ReadValue();
+  sparse_ = reader->ReadValue();
+  reader->ReadArray(&codes_);
+  reader->ReadArray(&offsets_);
+  reader->ReadArray(&primers_);
+}
+
+void TailTable::Save(IndexWriter* writer) const {
+  writer->WriteValue(tail_len_);
+  writer->WriteValue(sparse_);
+  writer->WriteArray(codes_);
+  writer->WriteArray(offsets_);
+  writer->WriteArray(primers_);
+}
+
+size_t TailTable::MaxBucketSize() const {
+  size_t max_size = 0;
+  for (size_t c = 0; c + 1 < offsets_.size(); ++c) {
+    max_size = std::max<size_t>(max_size, offsets_[c + 1] - offsets_[c]);
+  }
+  return max_size;
+}
+
+void TailTable::Release() {
+  codes_.Release();
+  offsets_.Release();
+  primers_.Release();
+}
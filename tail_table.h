@@ -0,0 +1,86 @@
+#ifndef TAIL_TABLE_H
+#define TAIL_TABLE_H
+
+#include <stddef.h>     // for size_t
+
+#include <algorithm>    // for std::lower_bound
+#include <vector>       // for std::vector
+
+#include "kmer.h"
+#include "mapped_array.h"
+
+class IndexReader;
+class IndexWriter;
+
+// How a TailTable finds the bucket of a code: a dense table has an offset
+// for each of the 4^tail_len codes, a sparse one only for the codes present,
+// found by binary search. Automatic lets the user of the table choose
+// whichever is smaller.
+enum TailIndex { kAutomaticTailIndex, kDenseTailIndex, kSparseTailIndex };
+
+// A table from tail codes to the primers listing each code, in compressed
+// sparse row form: one offset per code into a single array of primer
+// indexes. A lookup reads one contiguous run of indexes, in increasing
+// order, and the whole table is a few allocations which Release (or the
+// destructor) frees. A dense table is filled by a counting pass over all
+// 4^tail_len codes; a sparse one keeps the sorted distinct codes beside the
+// offsets, so its memory grows with the number of entries and tail_len can
+// go up to max_kmer_len.
+class TailTable {
+ public:
+  class Bucket {
+   public:
+    Bucket(const unsigned* first, const unsigned* last)
+        : first_(first), last_(last) {}
+    const unsigned* begin() const { return first_; }
+    const unsigned* end() const { return last_; }
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return first_ == last_; }
+
+   private:
+    const unsigned* first_;
+    const unsigned* last_;
+  };
+
+  // keys[i] lists the tail codes under which primer i is stored; a code
+  // listed twice for one primer stores it twice
+  TailTable(unsigned tail_len, const std::vector<std::vector<kmer_t>> &keys,
+      bool sparse = false);
+  // a table saved by Save, viewing the reader's mapping
+  explicit TailTable(IndexReader* reader);
+  void Save(IndexWriter* writer) const;
+
+  unsigned TailLength() const {
+    return tail_len_;
+  }
+  bool Sparse() const {
+    return sparse_;
+  }
+  // the total number of entries
+  size_t size() const {
+    return primers_.size();
+  }
+  // the primers stored under code, which must be below 4^TailLength()
+  Bucket operator[](kmer_t code) const {
+    size_t b = code;
+    if (sparse_) {
+      auto it = std::lower_bound(codes_.begin(), codes_.end(), code);
+      if (it == codes_.end() || *it != code) return Bucket(nullptr, nullptr);
+      b = it - codes_.begin();
+    }
+    return Bucket(primers_.data() + offsets_[b],
+        primers_.data() + offsets_[b + 1]);
+  }
+  size_t MaxBucketSize() const;
+  // frees the table; it must not be looked up again
+  void Release();
+
+ private:
+  unsigned tail_len_;
+  bool sparse_;
+  MappedArray<kmer_t> codes_;
+  MappedArray<unsigned> offsets_;
+  MappedArray<unsigned> primers_;
+};
+
+#endif